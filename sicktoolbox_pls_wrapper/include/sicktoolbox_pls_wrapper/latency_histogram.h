@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// fixed-size log-linear histograms for timing the driver loop.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_LATENCY_HISTOGRAM_H
+#define SICKTOOLBOX_PLS_WRAPPER_LATENCY_HISTOGRAM_H
+
+#include <time.h>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Nanoseconds on CLOCK_MONOTONIC, for timing intervals within the process.
+inline uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// A histogram of nanosecond durations in the style of HdrHistogram: values
+// below 32 ns get a bucket each, and every power of two above that is split
+// into 16 equal buckets, so any recorded value is known to within 1/16
+// (about 6%) from 1 ns up to about 36 minutes. Larger values land in the
+// top bucket. The memory is fixed and recording is a shift and an
+// increment, cheap enough to leave on for every scan.
+//
+// Not thread safe: record from one thread and read from the same one.
+class LatencyHistogram
+{
+public:
+  enum { SUB_BUCKET_BITS = 5,
+         SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+         HALF_SUB_BUCKETS = SUB_BUCKETS / 2,
+         MAX_SHIFT = 36,
+         BUCKETS = (MAX_SHIFT + 1) * HALF_SUB_BUCKETS + HALF_SUB_BUCKETS };
+
+  LatencyHistogram() { reset(); }
+
+  void record(uint64_t ns)
+  {
+    counts_[bucketIndex(ns)]++;
+    if (count_ == 0 || ns < min_)
+      min_ = ns;
+    if (ns > max_)
+      max_ = ns;
+    sum_ += ns;
+    count_++;
+  }
+
+  void reset();
+
+  uint64_t count() const { return count_; }
+  uint64_t min() const { return count_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  double mean() const { return count_ ? (double)sum_ / count_ : 0.0; }
+  // The smallest value that percentile percent of the recorded values
+  // are at or below, rounded up to the top of its bucket.
+  uint64_t valueAtPercentile(double percentile) const;
+
+  static unsigned bucketIndex(uint64_t ns)
+  {
+    if (ns < SUB_BUCKETS)
+      return ns;
+    unsigned shift = 63 - __builtin_clzll(ns) - (SUB_BUCKET_BITS - 1);
+    if (shift > MAX_SHIFT)
+      return BUCKETS - 1;
+    return shift * HALF_SUB_BUCKETS + (unsigned)(ns >> shift);
+  }
+  // Largest value that falls in the bucket.
+  static uint64_t bucketUpperBound(unsigned index);
+
+private:
+  uint64_t counts_[BUCKETS];
+  uint64_t count_;
+  uint64_t min_;
+  uint64_t max_;
+  uint64_t sum_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
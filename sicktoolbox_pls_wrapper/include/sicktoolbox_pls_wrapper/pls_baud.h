@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// getting a PLS back to a known baud rate quickly.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_BAUD_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_BAUD_H
+
+#include <string>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// A PLS keeps whatever session baud rate it was last switched to until it
+// is power cycled, and sicktoolbox's Initialize only finds it by trying
+// 9600, 19200, 38400 and 500000 in turn, timing out on each wrong guess.
+//
+// BaudCache remembers, in a small file per device, the rate each laser was
+// last left at, so that the next connection can go straight to it.
+class BaudCache
+{
+public:
+  // Caches under dir; an empty dir disables the cache.
+  BaudCache(const std::string &dir, const std::string &device);
+
+  // The cached baud rate, or 0 if there is none.
+  uint32_t load() const;
+  bool store(uint32_t baud) const;
+
+  const std::string &path() const { return path_; }
+
+private:
+  std::string path_;
+};
+
+// Talks to the PLS at baud and tells it to switch its session back to
+// 9600, which is where sicktoolbox's probe looks first. Returns true if the
+// PLS confirmed the switch within timeout seconds.
+bool pls_reset_session_baud(const std::string &device, uint32_t baud, double timeout);
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
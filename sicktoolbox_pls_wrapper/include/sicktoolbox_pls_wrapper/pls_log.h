@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+// binary PLS scan logs: a fixed header followed by fixed-stride records,
+// so a log can be mmapped and scan N found in O(1).
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_LOG_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_LOG_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <sys/types.h>
+#include "pls_scan.h"
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// On-disk layout, little-endian, all fields naturally aligned:
+//
+//   PlsLogHeader                    header_size bytes
+//   record 0                        record_size bytes
+//   record 1 ...
+//
+// Each record is a PlsLogRecord followed by ranges_per_record uint16_t raw
+// readings and, with PLS_LOG_STATUS in the header flags, as many bytes of
+// PlsScan::ReadingStatus, padded to a multiple of 8 bytes. Scans with fewer
+// readings than ranges_per_record are zero-padded; num_ranges says how
+// many are real.
+//
+// Version 1 logs have no status column; their records' flags are always 0.
+//
+// With PLS_LOG_LZ4 in the header flags the records come in blocks instead,
+// one per writer batch: a PlsLogBlock and then the LZ4-compressed records,
+// padded to a multiple of 8 bytes. The reader inflates the whole log on
+// open, so compressed logs read the same as plain ones.
+
+const char PLS_LOG_MAGIC[8] = { 'P', 'L', 'S', 'L', 'O', 'G', '\0', '\0' };
+const uint32_t PLS_LOG_VERSION = 2;
+
+// PlsLogHeader::flags
+const uint32_t PLS_LOG_LZ4 = 1 << 0;
+const uint32_t PLS_LOG_STATUS = 1 << 1;
+
+// PlsLogRecord::flags: which of the record's optional parts are real
+const uint8_t PLS_RECORD_STATUS = 1 << 0;         // the status column
+const uint8_t PLS_RECORD_DEVICE_STATUS = 1 << 1;  // device_status
+
+struct PlsLogHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;       // offset of the first record
+  uint32_t record_size;       // stride between records
+  uint32_t ranges_per_record;
+  uint32_t baud;              // session baud rate, e.g. 38400
+  uint32_t units;             // SickPLS::sick_pls_measuring_units_t
+  uint64_t scan_count;        // as of the last flush; see PlsLogReader::size()
+  uint32_t flags;             // PLS_LOG_* format bits
+  uint32_t reserved;
+  char device[80];            // device path, nul-terminated
+};
+
+struct PlsLogRecord
+{
+  uint64_t stamp_ns;          // host time the scan was read, ns since the epoch
+  uint16_t num_ranges;
+  uint8_t device_status;      // the status byte that ended the scan's telegram
+  uint8_t flags;              // PLS_RECORD_* bits
+  uint32_t reserved;
+
+  const uint16_t *ranges() const { return reinterpret_cast<const uint16_t *>(this + 1); }
+  uint16_t *ranges() { return reinterpret_cast<uint16_t *>(this + 1); }
+  // Only in logs with PLS_LOG_STATUS.
+  const uint8_t *status(uint32_t ranges_per_record) const
+  {
+    return reinterpret_cast<const uint8_t *>(ranges() + ranges_per_record);
+  }
+  uint8_t *status(uint32_t ranges_per_record)
+  {
+    return reinterpret_cast<uint8_t *>(ranges() + ranges_per_record);
+  }
+};
+
+struct PlsLogBlock
+{
+  uint32_t raw_size;          // records in the block times record_size
+  uint32_t compressed_size;   // bytes of LZ4 data that follow, before padding
+  uint32_t scan_count;
+  uint32_t reserved;
+};
+
+// Whether this build can write and read PLS_LOG_LZ4 logs.
+bool pls_log_lz4_supported();
+
+// Bytes per record for a given number of readings per scan and
+// PlsLogHeader::flags.
+size_t pls_log_record_size(uint32_t ranges_per_record, uint32_t flags = 0);
+
+// Buffers records in memory and writes them out a batch at a time. The
+// header's scan_count is rewritten on every flush, so a log cut short by a
+// crash loses at most the unflushed batch.
+class PlsLogWriter : boost::noncopyable
+{
+public:
+  PlsLogWriter();
+  ~PlsLogWriter();
+
+  // ranges_per_record of 0 means "use the size of the first scan". With
+  // compress, each batch is written as one LZ4 block; with status, records
+  // keep each reading's status as well.
+  bool open(const std::string &path, const std::string &device, uint32_t baud,
+            uint32_t units, uint32_t ranges_per_record = 0, size_t batch_size = 64,
+            bool compress = false, bool status = true);
+  // For when the units aren't known until after the laser is initialized.
+  void setUnits(uint32_t units) { header_.units = units; }
+  bool append(uint64_t stamp_ns, const uint32_t *range_values, uint32_t n_range_values);
+  // With the scan's status columns, where it has them.
+  bool append(const PlsScan &scan);
+  bool flush();
+  // fdatasync, for what has been flushed so far.
+  bool sync();
+  bool close();
+
+  bool isOpen() const { return fd_ >= 0; }
+  uint64_t scanCount() const { return header_.scan_count + pending_; }
+  // Size of the file so far, not counting the unflushed batch.
+  uint64_t bytes() const { return end_; }
+  const std::string &error() const { return error_; }
+
+private:
+  // The next record in the batch with its ranges filled in, or NULL.
+  PlsLogRecord *addRecord(uint64_t stamp_ns, const uint32_t *range_values, uint32_t n_range_values);
+  bool commitRecord();
+  bool writeHeader();
+  bool writeAll(const char *p, size_t length, off_t offset);
+  bool fail(const std::string &what);
+
+  int fd_;
+  PlsLogHeader header_;
+  uint64_t end_;
+  std::vector<char> batch_;
+  std::vector<char> compressed_;
+  size_t batch_size_;
+  size_t pending_;
+  std::string error_;
+};
+
+// Maps a log read-only. Records are accessed in place, no copies, except
+// in compressed logs, which are inflated into memory.
+class PlsLogReader : boost::noncopyable
+{
+public:
+  PlsLogReader();
+  ~PlsLogReader();
+
+  bool open(const std::string &path);
+  void close();
+
+  const PlsLogHeader &header() const { return *header_; }
+  // Number of complete records in the file. Trusts the file size over the
+  // header, so logs whose writer died before its last flush still read.
+  uint64_t size() const { return size_; }
+  const PlsLogRecord &operator[](uint64_t i) const
+  {
+    return *reinterpret_cast<const PlsLogRecord *>(data_ + header_->header_size +
+                                                   i * header_->record_size);
+  }
+  const std::string &error() const { return error_; }
+
+private:
+  bool fail(const std::string &what);
+  void inflate();
+
+  const char *data_;
+  size_t length_;
+  bool mapped_;
+  std::vector<char> inflated_;
+  const PlsLogHeader *header_;
+  uint64_t size_;
+  std::string error_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
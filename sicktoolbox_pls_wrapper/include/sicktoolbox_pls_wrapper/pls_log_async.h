@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////////
+// writes scan logs on a thread of their own, so a slow disk costs logged
+// scans rather than laser frames.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_LOG_ASYNC_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_LOG_ASYNC_H
+
+#include <cstdio>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include "pls_log.h"
+#include "pls_scan.h"
+#include "scan_ring.h"
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+struct AsyncLogOptions
+{
+  AsyncLogOptions()
+    : queue_size(256), batch_size(64), ascii(false), compress(false), rotate_bytes(0),
+      rotate_seconds(0), sync_seconds(0)
+  {
+  }
+
+  size_t queue_size;      // scans waiting for the disk before new ones are dropped
+  size_t batch_size;      // scans per write, and per LZ4 block
+  bool ascii;             // "%.6f %d %d ...\n" per scan instead of the binary log
+  bool compress;          // LZ4 blocks; binary logs only
+  uint64_t rotate_bytes;  // start a new file once one grows past this; 0 never
+  double rotate_seconds;  // or once it has been open this long; 0 never
+  double sync_seconds;    // flush and fdatasync at least this often; 0 only when a file is closed
+};
+
+// The thread that calls append hands each scan over through a lock-free
+// queue and never touches the disk. When the queue is full the scan is
+// dropped and counted instead of holding up the caller.
+//
+// open, setUnits, append and close belong to one thread; the counters and
+// error may be read from any.
+class AsyncLogWriter : boost::noncopyable
+{
+public:
+  AsyncLogWriter();
+  ~AsyncLogWriter();
+
+  // Opens the first file and starts the writer thread. path is used as it
+  // is unless the log rotates; then every file, the first one included, is
+  // named after when it was started, e.g. scans-20130412-183002.plslog.
+  bool open(const std::string &path, const std::string &device, uint32_t baud, uint32_t units,
+            const AsyncLogOptions &options);
+  // For when the units aren't known until after the laser is initialized.
+  void setUnits(uint32_t units) { units_ = units; }
+  // Queues a copy of scan. Returns false if it was dropped.
+  bool append(const PlsScan &scan);
+  // Writes out everything still queued, then closes the file.
+  bool close();
+
+  bool isOpen() const { return running_; }
+  // The writer thread gave up on the log; see error().
+  bool failed() const { return failed_; }
+  std::string error() const;
+
+  unsigned long written() const { return written_; }
+  unsigned long dropped() const { return dropped_; }
+  unsigned long files() const { return files_; }
+  unsigned long syncs() const { return syncs_; }
+
+private:
+  void run();
+  void signal();
+  bool writeScan(const PlsScan &scan);
+  bool maintain(uint64_t now_ns);
+  bool openFile();
+  bool closeFile();
+  bool syncFile();
+  uint64_t fileBytes() const;
+  std::string nextPath() const;
+  bool fail(const std::string &what);
+
+  AsyncLogOptions options_;
+  std::string path_;
+  std::string device_;
+  uint32_t baud_;
+  volatile uint32_t units_;
+
+  boost::scoped_ptr<ScanRing<PlsScan *> > ring_;
+  boost::scoped_ptr<PlsScanPool> pool_;
+  boost::thread thread_;
+  int event_fd_;
+  volatile bool running_;
+  volatile bool failed_;
+  volatile unsigned long written_;
+  volatile unsigned long dropped_;
+  volatile unsigned long files_;
+  volatile unsigned long syncs_;
+  mutable boost::mutex error_mutex_;
+  std::string error_;
+
+  // The writer thread's, once it is running
+  PlsLogWriter binary_;
+  FILE *ascii_;
+  uint64_t ascii_bytes_;
+  uint64_t opened_ns_;
+  uint64_t synced_ns_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
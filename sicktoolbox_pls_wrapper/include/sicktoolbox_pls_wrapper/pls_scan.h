@@ -0,0 +1,223 @@
+///////////////////////////////////////////////////////////////////////////////
+// the scan buffer every part of the wrapper passes around, and a pool to
+// recycle them without allocating.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_SCAN_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_SCAN_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <pthread.h>
+#include "range_conversion.h"
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// One scan: the readings as columns, each on its own cache lines so the
+// conversion and filter kernels stream through exactly the data they use,
+// and the stamps that go with it.
+//
+// ranges is always valid for size readings; the other columns only when
+// their bit is set in fields. The PLS reports no intensities and no clock
+// of its own, but readers of those columns are written against these so a
+// source that has them needs no new plumbing.
+//
+// A PlsScan is 2.5 KB and is never copied: it is filled in place, handed
+// along by pointer and given back to the PlsScanPool it came from. One on
+// the stack is fine for a tool that only ever needs the one.
+struct PlsScan : boost::noncopyable
+{
+  enum
+  {
+    MAX_READINGS = 361, // SickPLS::SICK_MAX_NUM_MEASUREMENTS
+    CACHE_LINE = 64
+  };
+
+  // Bits of fields
+  enum Field
+  {
+    INTENSITIES = 1 << 0,
+    STATUS = 1 << 1,
+    DEVICE_STAMP = 1 << 2,
+    DEVICE_STATUS = 1 << 3
+  };
+
+  // Bits of status. The low three are the flags the PLS sends in the top
+  // bits of every reading, in the same order; INVALID is worked out here,
+  // so that consumers can skip bad readings with a mask.
+  enum ReadingStatus
+  {
+    WARNING_FIELD = 1 << 0,     // inside the configured warning field
+    PROTECTIVE_FIELD = 1 << 1,  // inside the configured protective field
+    DAZZLE = 1 << 2,            // the receiver was dazzled
+    DEVICE_FLAGS = WARNING_FIELD | PROTECTIVE_FIELD | DAZZLE,
+    INVALID = 1 << 7            // not a distance: an out-of-range code
+  };
+
+  uint32_t ranges[MAX_READINGS] __attribute__((aligned(CACHE_LINE)));     // raw readings, scaled by the units mode
+  uint16_t intensities[MAX_READINGS] __attribute__((aligned(CACHE_LINE)));
+  uint8_t status[MAX_READINGS] __attribute__((aligned(CACHE_LINE)));      // ReadingStatus bits of each reading
+
+  uint32_t size;              // readings in this scan
+  uint32_t fields;            // Field bits of the optional columns that are valid
+  uint64_t host_stamp_ns;     // wall clock when the read returned, i.e. at the end of the scan
+  uint64_t read_begin_ns;     // read call and return, on the monotonic clock
+  uint64_t read_end_ns;
+  uint64_t device_stamp_ns;   // the device's own clock, if it has one (DEVICE_STAMP)
+  uint8_t device_status;      // the status byte that ends the scan's telegram (DEVICE_STATUS)
+
+  PlsScan() { clear(); }
+
+  // Empties the scan for reuse, without touching the columns.
+  void clear()
+  {
+    size = 0;
+    fields = 0;
+    host_stamp_ns = 0;
+    read_begin_ns = 0;
+    read_end_ns = 0;
+    device_stamp_ns = 0;
+    device_status = 0;
+  }
+
+  bool has(Field field) const { return (fields & field) != 0; }
+
+  // Fills in status from the ranges alone, for sources that drop the
+  // device's flags on the way (sicktoolbox does).
+  void deriveStatus()
+  {
+    for (uint32_t i = 0; i < size; i++)
+      status[i] = ranges[i] > PLS_MAX_VALID_RANGE ? (uint8_t)INVALID : 0;
+    fields |= STATUS;
+  }
+
+  // The explicit copy, for handing a scan to something that outlives it:
+  // only the readings in use and the columns that are valid.
+  void assign(const PlsScan &other)
+  {
+    size = other.size < (uint32_t)MAX_READINGS ? other.size : (uint32_t)MAX_READINGS;
+    fields = other.fields;
+    host_stamp_ns = other.host_stamp_ns;
+    read_begin_ns = other.read_begin_ns;
+    read_end_ns = other.read_end_ns;
+    device_stamp_ns = other.device_stamp_ns;
+    device_status = other.device_status;
+    memcpy(ranges, other.ranges, size * sizeof(ranges[0]));
+    if (has(INTENSITIES))
+      memcpy(intensities, other.intensities, size * sizeof(intensities[0]));
+    if (has(STATUS))
+      memcpy(status, other.status, size * sizeof(status[0]));
+  }
+};
+
+// A fixed number of PlsScans in one cache-aligned block, allocated up front.
+// acquire and release may be called from any thread; the lock inherits
+// priority, so a real-time reader is never held up for long behind a
+// low-priority publisher giving a scan back.
+class PlsScanPool : boost::noncopyable
+{
+public:
+  explicit PlsScanPool(size_t size) : scans_(NULL), size_(0)
+  {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&mutex_, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    void *block = NULL;
+    if (size == 0 || posix_memalign(&block, PlsScan::CACHE_LINE, size * sizeof(PlsScan)) != 0)
+      throw std::bad_alloc();
+    scans_ = static_cast<PlsScan *>(block);
+    size_ = size;
+    free_.reserve(size);
+    for (size_t i = 0; i < size; i++)
+      free_.push_back(new (scans_ + i) PlsScan);
+  }
+
+  ~PlsScanPool()
+  {
+    // PlsScan has nothing to destroy
+    free(scans_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  size_t size() const { return size_; }
+
+  // An empty scan, or NULL if every one is in use.
+  PlsScan *acquire()
+  {
+    PlsScan *scan = NULL;
+    pthread_mutex_lock(&mutex_);
+    if (!free_.empty())
+    {
+      scan = free_.back();
+      free_.pop_back();
+    }
+    pthread_mutex_unlock(&mutex_);
+    if (scan)
+      scan->clear();
+    return scan;
+  }
+
+  // Gives back a scan from acquire. NULL is ignored.
+  void release(PlsScan *scan)
+  {
+    if (!scan)
+      return;
+    pthread_mutex_lock(&mutex_);
+    free_.push_back(scan); // never reallocates: reserved for all of them
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  size_t available()
+  {
+    pthread_mutex_lock(&mutex_);
+    size_t n = free_.size();
+    pthread_mutex_unlock(&mutex_);
+    return n;
+  }
+
+private:
+  PlsScan *scans_;
+  size_t size_;
+  std::vector<PlsScan *> free_;
+  pthread_mutex_t mutex_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// raw serial port access for talking to a PLS without sicktoolbox.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_SERIAL_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_SERIAL_H
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Opens device raw, 8N1, non-blocking, at baud (one of the rates the PLS
+// supports). Returns the fd, or -1 with the reason in error.
+int pls_open_serial(const std::string &device, uint32_t baud, std::string *error);
+
+bool pls_set_serial_baud(int fd, uint32_t baud);
+
+// Writes all of data, waiting for the port to drain. Returns false on error.
+bool pls_write_serial(int fd, const uint8_t *data, size_t length);
+
+// Waits up to timeout seconds for data and reads what there is, up to
+// size bytes. Returns the byte count, 0 on timeout or -1 on error.
+ssize_t pls_read_serial(int fd, uint8_t *buffer, size_t size, double timeout);
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
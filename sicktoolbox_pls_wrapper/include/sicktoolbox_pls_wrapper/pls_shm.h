@@ -0,0 +1,289 @@
+///////////////////////////////////////////////////////////////////////////////
+// a shared-memory ring of scans for consumers on the same host as the
+// driver: the layout, the driver's writer and a header-only reader.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_SHM_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_SHM_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Layout of the POSIX shared memory segment (shm_open name, e.g. "/sickpls"):
+//
+//   PlsShmHeader                    header_size bytes
+//   slot 0                          slot_size bytes
+//   slot 1 ...                      slot_count slots in all
+//
+// Scans are numbered from 1 and scan k goes in slot k % slot_count. Each slot
+// is a seqlock: its sequence is odd while the writer is in it, so a reader
+// takes a copy of the sequence, reads the slot in place and then checks the
+// sequence didn't change. header.futex is bumped after every scan, for
+// readers to FUTEX_WAIT on. The writer never waits for readers.
+
+const char PLS_SHM_MAGIC[8] = { 'P', 'L', 'S', 'S', 'H', 'M', '\0', '\0' };
+const uint32_t PLS_SHM_VERSION = 1;
+const uint32_t PLS_SHM_MAX_RANGES = 361; // SickPLS::SICK_MAX_NUM_MEASUREMENTS
+
+struct PlsShmHeader
+{
+  char magic[8];              // written last, once the rest is valid
+  uint32_t version;
+  uint32_t header_size;       // offset of slot 0
+  uint32_t slot_size;
+  uint32_t slot_count;
+  uint32_t max_ranges;
+  uint32_t writer_pid;        // 0 once the writer has closed the segment
+  float scale;                // metres per raw reading
+  float angle_min;            // angle of reading 0, as in the LaserScan
+  float angle_increment;
+  float scan_time;
+  char frame_id[64];
+  char device[80];
+  // Written with every scan, on a cache line of their own
+  volatile uint64_t latest __attribute__((aligned(64))); // last scan written, 0 for none
+  volatile uint32_t futex;
+};
+
+struct PlsShmSlot
+{
+  volatile uint32_t sequence;
+  uint32_t num_ranges;
+  uint64_t scan;
+  uint64_t stamp_ns;          // start of the scan, ROS time
+  uint16_t ranges[PLS_SHM_MAX_RANGES]; // raw readings, as in range_values
+} __attribute__((aligned(64)));
+
+// A scan copied out of the ring.
+struct PlsShmScan
+{
+  uint64_t scan;
+  uint64_t stamp_ns;
+  uint32_t num_ranges;
+  uint16_t ranges[PLS_SHM_MAX_RANGES];
+};
+
+// The driver's side. Writing a scan is a couple of hundred bytes of memcpy
+// and a FUTEX_WAKE.
+class PlsShmWriter : boost::noncopyable
+{
+public:
+  PlsShmWriter();
+  ~PlsShmWriter();
+
+  // Creates the segment, or takes over the one a previous writer left so
+  // that readers still mapping it carry on.
+  bool open(const std::string &name, const std::string &device, uint32_t slot_count = 16);
+  // What readers need to make a LaserScan of the readings.
+  void setGeometry(float scale, float angle_min, float angle_increment, float scan_time,
+                   const std::string &frame_id);
+  void write(uint64_t stamp_ns, const uint32_t *range_values, uint32_t n_range_values);
+  void close();
+
+  bool isOpen() const { return header_ != NULL; }
+  uint64_t scans() const { return scans_; }
+  const std::string &error() const { return error_; }
+
+private:
+  bool fail(const std::string &what);
+
+  int fd_;
+  PlsShmHeader *header_;
+  size_t length_;
+  uint64_t scans_;
+  std::string error_;
+};
+
+// The consumer's side; needs nothing but this header (and -lrt on older
+// glibc). Maps the segment read-only, so it can't disturb the driver or
+// other readers.
+class PlsShmReader : boost::noncopyable
+{
+public:
+  PlsShmReader() : fd_(-1), header_(NULL), length_(0) {}
+  ~PlsShmReader() { close(); }
+
+  bool open(const std::string &name)
+  {
+    close();
+    fd_ = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd_ < 0)
+      return fail("Can't open " + name + ": " + strerror(errno));
+    struct stat st;
+    if (fstat(fd_, &st) < 0 || st.st_size < (off_t)sizeof(PlsShmHeader))
+      return fail(name + " is too short to be a scan ring");
+    length_ = st.st_size;
+    void *p = mmap(NULL, length_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED)
+      return fail("Can't map " + name + ": " + strerror(errno));
+    header_ = static_cast<const PlsShmHeader *>(p);
+    if (memcmp(header_->magic, PLS_SHM_MAGIC, sizeof(PLS_SHM_MAGIC)) != 0)
+      return fail(name + " isn't a scan ring, or its writer hasn't finished setting it up");
+    if (header_->version != PLS_SHM_VERSION || header_->slot_size != sizeof(PlsShmSlot) ||
+        header_->max_ranges != PLS_SHM_MAX_RANGES || header_->slot_count == 0 ||
+        (uint64_t)header_->header_size + (uint64_t)header_->slot_count * header_->slot_size > length_)
+      return fail(name + " has a layout this reader doesn't know");
+    return true;
+  }
+
+  void close()
+  {
+    if (header_)
+      munmap(const_cast<PlsShmHeader *>(header_), length_);
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+    header_ = NULL;
+    length_ = 0;
+  }
+
+  bool isOpen() const { return header_ != NULL; }
+  const PlsShmHeader &header() const { return *header_; }
+  const std::string &error() const { return error_; }
+
+  // Number of the newest scan, 0 if there's none yet.
+  uint64_t latest() const { return header_->latest; }
+
+  // Waits up to timeout seconds for latest() to be anything but after.
+  // A restarted writer numbers from 1 again, hence "anything but".
+  bool waitForScan(uint64_t after, double timeout) const
+  {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    add_seconds(deadline, timeout);
+    for (;;) {
+      uint32_t futex = header_->futex;
+      __sync_synchronize(); // futex before latest, as the writer bumps them the other way round
+      if (header_->latest != after)
+        return true;
+      struct timespec now, remaining;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+      remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+      if (remaining.tv_nsec < 0) {
+        remaining.tv_sec--;
+        remaining.tv_nsec += 1000000000;
+      }
+      if (remaining.tv_sec < 0)
+        return false;
+      syscall(SYS_futex, &header_->futex, FUTEX_WAIT, futex, &remaining, NULL, 0);
+    }
+  }
+
+  // Zero-copy access to a scan in place. Returns NULL if it has already
+  // been overwritten or is being written. Once done with the slot, the
+  // data is only good if release() says so.
+  const PlsShmSlot *acquire(uint64_t scan, uint32_t &sequence) const
+  {
+    if (scan == 0)
+      return NULL;
+    const PlsShmSlot *slot = reinterpret_cast<const PlsShmSlot *>(
+      reinterpret_cast<const char *>(header_) + header_->header_size +
+      (scan % header_->slot_count) * header_->slot_size);
+    sequence = slot->sequence;
+    __sync_synchronize(); // sequence before the contents
+    if ((sequence & 1) || slot->scan != scan)
+      return NULL;
+    return slot;
+  }
+
+  bool release(const PlsShmSlot *slot, uint32_t sequence) const
+  {
+    __sync_synchronize(); // contents before the sequence
+    return slot->sequence == sequence;
+  }
+
+  // Copies out a scan; false if it's gone.
+  bool read(uint64_t scan, PlsShmScan &out) const
+  {
+    uint32_t sequence;
+    const PlsShmSlot *slot = acquire(scan, sequence);
+    if (!slot)
+      return false;
+    out.scan = slot->scan;
+    out.stamp_ns = slot->stamp_ns;
+    out.num_ranges = slot->num_ranges < PLS_SHM_MAX_RANGES ? slot->num_ranges : PLS_SHM_MAX_RANGES;
+    memcpy(out.ranges, slot->ranges, out.num_ranges * sizeof(out.ranges[0]));
+    return release(slot, sequence);
+  }
+
+  // Copies out the newest scan, retrying if the writer laps us.
+  bool readLatest(PlsShmScan &out) const
+  {
+    for (int attempt = 0; attempt < 4; attempt++)
+      if (read(latest(), out))
+        return true;
+    return false;
+  }
+
+private:
+  static void add_seconds(struct timespec &ts, double seconds)
+  {
+    if (seconds < 0)
+      seconds = 0;
+    time_t whole = (time_t)seconds;
+    ts.tv_sec += whole;
+    ts.tv_nsec += (long)((seconds - whole) * 1e9);
+    if (ts.tv_nsec >= 1000000000) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000;
+    }
+  }
+
+  bool fail(const std::string &what)
+  {
+    error_ = what;
+    close();
+    return false;
+  }
+
+  int fd_;
+  const PlsShmHeader *header_;
+  size_t length_;
+  std::string error_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////
+// a PLS simulated on a pty, for running the driver and tools without
+// the hardware.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_SIMULATOR_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_SIMULATOR_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+struct PlsSimulatorConfig
+{
+  PlsSimulatorConfig()
+    : baud(9600), scan_rate(75), paced(true), num_values(361), jitter(0), drop_rate(0),
+      crc_error_rate(0), seed(1)
+  {
+  }
+
+  uint32_t baud;          // session baud rate at power-on
+  double scan_rate;       // Hz the mirror turns at
+  bool paced;             // carry no more bytes than the baud rate would
+  uint32_t num_values;    // readings per scan: 181 or 361
+  double jitter;          // standard deviation of when each scan goes out, in seconds
+  double drop_rate;       // fraction of scan telegrams that lose a byte
+  double crc_error_rate;  // fraction of scan telegrams with a byte corrupted
+  unsigned seed;
+};
+
+// One simulated PLS on the master side of a pty; point a driver at
+// devicePath(). It powers up at config.baud and answers PLS_CMD_SWITCH_MODE
+// (session baud, continuous and on-request output) and 0x30 requests for
+// measured values, ACKing every telegram and NACKing bad checksums, the
+// way PlsStream and pls_reset_session_baud use the PLS. sicktoolbox's own
+// initialization asks for more than that and isn't expected to work.
+//
+// A pty has no line speed of its own, so the simulator paces its output to
+// the session baud rate itself, and ignores a host whose port is set to
+// any other rate, as a real PLS would look to one. The scene is a 8 x 6 m
+// room with something moving about in it, plus a couple of cm of noise.
+//
+// Not thread safe: one thread runs any number of simulators, polling fd()
+// and calling handleInput and service (see standalone/pls_sim.cpp).
+class PlsSimulator : boost::noncopyable
+{
+public:
+  explicit PlsSimulator(const PlsSimulatorConfig &config);
+  ~PlsSimulator();
+
+  bool open();
+  void close();
+  bool isOpen() const { return master_ >= 0; }
+
+  // The pty slave, e.g. /dev/pts/7.
+  const std::string &devicePath() const { return device_path_; }
+  // Readable when the host has sent something.
+  int fd() const { return master_; }
+  uint32_t baud() const { return baud_; }
+
+  // Reads and answers whatever the host has sent.
+  bool handleInput(uint64_t now_ns);
+  // Starts the scans and sends the bytes that are due by now. Returns when
+  // it next has something to do, on the monotonic clock.
+  uint64_t service(uint64_t now_ns);
+
+  const std::string &error() const { return error_; }
+
+  unsigned long scans() const { return scans_; }
+  unsigned long scansSent() const { return scans_sent_; }
+  unsigned long commands() const { return commands_; }
+  unsigned long bytesDropped() const { return bytes_dropped_; }
+  unsigned long crcErrors() const { return crc_errors_; }
+
+private:
+  void handleTelegram(const uint8_t *payload, size_t length, uint64_t now_ns);
+  void reply(const uint8_t *payload, size_t length, uint64_t now_ns);
+  void queue(const uint8_t *data, size_t length, uint64_t now_ns);
+  void sendScan(uint64_t now_ns);
+  void flush(uint64_t now_ns);
+  uint32_t hostBaud() const;
+  double random();
+  double gaussian();
+
+  PlsSimulatorConfig config_;
+  int master_;
+  int slave_;
+  std::string device_path_;
+  std::string error_;
+  unsigned seed_;
+
+  uint32_t baud_;
+  uint32_t pending_baud_;   // switched to once the reply has gone out
+  bool continuous_;
+  bool scan_requested_;
+
+  uint64_t period_ns_;
+  uint64_t grid_ns_;        // when the current scan was due, before jitter
+  uint64_t next_scan_ns_;
+  uint64_t scan_index_;
+  std::vector<double> room_;  // cm, per reading
+
+  std::vector<uint8_t> in_;
+  std::vector<uint8_t> out_;
+  size_t out_start_;
+  uint64_t tx_start_ns_;    // when the line started on out_[out_start_]
+  bool scan_in_flight_;
+  size_t scan_end_;         // out_ offset just past the scan telegram on the line
+
+  unsigned long scans_;
+  unsigned long scans_sent_;
+  unsigned long commands_;
+  unsigned long bytes_dropped_;
+  unsigned long crc_errors_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+// reading a PLS in continuous output mode, bypassing sicktoolbox.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_STREAM_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_STREAM_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "pls_scan.h"
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Puts the PLS into continuous output and reads its measured-values
+// telegrams straight off the port. sicktoolbox asks for every scan and
+// copies each reply through its buffer monitor a byte at a time; here the
+// PLS sends scans unasked and each read() takes everything that has arrived
+// into one large buffer, which is parsed in place. A partial telegram is
+// only ever moved once, to the front of the buffer when the buffer runs
+// out, so every complete telegram is contiguous and ranges decode straight
+// from the buffer into the caller's array.
+//
+// Not thread safe; use from one thread.
+class PlsStream : boost::noncopyable
+{
+public:
+  explicit PlsStream(size_t buffer_size = 1 << 16);
+  ~PlsStream();
+
+  // Finds the PLS on device, trying cached_baud (if not 0) before the
+  // supported rates, switches it to baud and starts continuous output.
+  bool open(const std::string &device, uint32_t baud, uint32_t cached_baud = 0);
+  // Stops continuous output and puts the PLS back to 9600.
+  void close();
+  bool isOpen() const { return fd_ >= 0; }
+
+  // Waits up to timeout seconds for the next scan and decodes its ranges
+  // into range_values, which must hold SickPLS::SICK_MAX_NUM_MEASUREMENTS.
+  // Returns 1 for a scan, 0 on timeout and -1 if the port failed.
+  int next(uint32_t *range_values, uint32_t &n_range_values, double timeout);
+  // The same into a scan, with each reading's flags in status and the
+  // telegram's status byte in device_status.
+  int next(PlsScan &scan, double timeout);
+
+  // Counters, written by the reading thread and safe to read from any.
+  unsigned long telegrams() const { return telegrams_; }
+  unsigned long crcErrors() const { return crc_errors_; }
+  unsigned long bytesDiscarded() const { return discarded_; }
+  unsigned long long bytesRead() const { return bytes_read_; }
+  unsigned long reads() const { return reads_; }
+
+  const std::string &error() const { return error_; }
+
+private:
+  bool command(uint8_t mode, double timeout);
+  // Waits up to timeout for data and appends what there is to the buffer.
+  int fill(double timeout);
+  // The next valid telegram in the buffer, or NULL if there isn't a whole
+  // one yet. Valid until the next fill().
+  const uint8_t *nextTelegram();
+  // The next measured-values telegram and its number of values.
+  int nextScan(double timeout, const uint8_t *&telegram, uint32_t &n);
+
+  int fd_;
+  uint32_t baud_;
+  std::vector<uint8_t> buffer_;
+  size_t start_;
+  size_t end_;
+  std::string error_;
+  volatile unsigned long telegrams_;
+  volatile unsigned long crc_errors_;
+  volatile unsigned long discarded_;
+  volatile unsigned long long bytes_read_;
+  volatile unsigned long reads_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// framing and checksums for PLS serial telegrams.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_TELEGRAM_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_TELEGRAM_H
+
+#include <cstddef>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// A telegram is
+//
+//   STX  address  length (2)  payload (length bytes)  CRC (2)
+//
+// with the length and CRC little-endian, the length counting the payload
+// only, and the CRC covering everything from the STX to the end of the
+// payload. The payload starts with the command (host to PLS) or response
+// (PLS to host) byte. The PLS acknowledges every telegram it receives with
+// a single ACK or NACK byte before it answers.
+
+const uint8_t PLS_STX = 0x02;
+const uint8_t PLS_ACK = 0x06;
+const uint8_t PLS_NACK = 0x15;
+const uint8_t PLS_HOST_ADDRESS = 0x00;    // telegrams to the PLS
+const uint8_t PLS_DEVICE_ADDRESS = 0x80;  // telegrams from the PLS
+const size_t PLS_TELEGRAM_OVERHEAD = 6;
+const size_t PLS_MAX_PAYLOAD = 812;
+
+// Commands, and the response code the PLS answers each with.
+const uint8_t PLS_CMD_SWITCH_MODE = 0x20;
+const uint8_t PLS_RESPONSE_OFFSET = 0x80;
+const uint8_t PLS_RESP_MEASURED_VALUES = 0xb0;
+
+// PLS_CMD_SWITCH_MODE modes, besides the baud rates from pls_baud_mode.
+const uint8_t PLS_MODE_CONTINUOUS = 0x24;  // send every scan unasked
+const uint8_t PLS_MODE_ON_REQUEST = 0x25;  // only send scans when asked
+
+// The SICK checksum: a CRC-16 with polynomial 0x8005 that folds in the
+// data two bytes at a time, one byte per step. pls_crc16 does it eight
+// bytes per table lookup; pls_crc16_bitwise is the manual's loop.
+uint16_t pls_crc16(const uint8_t *data, size_t length);
+uint16_t pls_crc16_bitwise(const uint8_t *data, size_t length);
+
+// The PLS_CMD_SWITCH_MODE mode that selects a session baud rate, or 0 if
+// the PLS doesn't support it.
+uint8_t pls_baud_mode(uint32_t baud);
+
+// Frames payload into telegram, which must hold length + PLS_TELEGRAM_OVERHEAD
+// bytes. Returns the telegram length. Telegrams go to the PLS unless
+// address says otherwise.
+size_t pls_build_telegram(const uint8_t *payload, uint16_t length, uint8_t *telegram,
+                          uint8_t address = PLS_HOST_ADDRESS);
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
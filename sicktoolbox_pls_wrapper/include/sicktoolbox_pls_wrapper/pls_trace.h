@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+// per-scan timing trace files written by the driver.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_TRACE_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_TRACE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// On-disk layout, little-endian: a PlsTraceHeader followed by one
+// PlsTraceRecord per published scan, record_size bytes apart.
+
+const char PLS_TRACE_MAGIC[8] = { 'P', 'L', 'S', 'T', 'R', 'A', 'C', 'E' };
+const uint32_t PLS_TRACE_VERSION = 1;
+
+struct PlsTraceHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;       // offset of the first record
+  uint32_t record_size;       // stride between records
+  uint32_t reserved;
+  char device[80];            // device path, nul-terminated
+};
+
+// All durations in nanoseconds, saturated at 2^32 - 1 (about 4.3 s).
+struct PlsTraceRecord
+{
+  uint64_t stamp_ns;          // scan start time, ns since the epoch
+  uint32_t read_ns;           // time spent in GetSickScan
+  uint32_t convert_ns;        // building the message
+  uint32_t publish_ns;        // handing it to the publisher
+  uint32_t latency_ns;        // scan start to publish
+  uint32_t interval_ns;       // since the previous scan was read
+  uint16_t num_ranges;
+  uint16_t flags;             // reserved, 0
+};
+
+// Buffers records and writes them a batch at a time, from the thread that
+// appends them.
+class PlsTraceWriter : boost::noncopyable
+{
+public:
+  PlsTraceWriter();
+  ~PlsTraceWriter();
+
+  bool open(const std::string &path, const std::string &device, size_t batch_size = 256);
+  bool append(const PlsTraceRecord &record)
+  {
+    if (fd_ < 0)
+      return false;
+    batch_[pending_] = record;
+    if (++pending_ == batch_.size())
+      return flush();
+    return true;
+  }
+  bool flush();
+  bool close();
+
+  bool isOpen() const { return fd_ >= 0; }
+  const std::string &error() const { return error_; }
+
+  static uint32_t saturate(uint64_t ns) { return ns > 0xffffffffULL ? 0xffffffffU : (uint32_t)ns; }
+
+private:
+  bool fail(const std::string &what);
+
+  int fd_;
+  std::vector<PlsTraceRecord> batch_;
+  size_t pending_;
+  std::string error_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
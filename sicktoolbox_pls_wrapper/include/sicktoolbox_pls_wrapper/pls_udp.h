@@ -0,0 +1,300 @@
+///////////////////////////////////////////////////////////////////////////////
+// scans as fixed-layout UDP datagrams, usually multicast: the driver's
+// batched sender and a header-only receiver for consumers without ROS.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_UDP_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_UDP_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// One datagram per scan, everything little-endian:
+//
+//   PlsUdpHeader                    header_size bytes
+//   uint16_t ranges[num_ranges]     raw readings, as in range_values
+//
+// A full 361-reading scan is 770 bytes, well inside one Ethernet MTU, so a
+// scan is never fragmented. Sequence numbers count every scan a sensor
+// sent, so a receiver can tell how many it missed.
+
+const uint32_t PLS_UDP_MAGIC = 0x55534c50; // "PLSU" on the wire
+const uint16_t PLS_UDP_VERSION = 1;
+const uint32_t PLS_UDP_MAX_RANGES = 361; // SickPLS::SICK_MAX_NUM_MEASUREMENTS
+
+struct PlsUdpHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size;      // offset of the ranges
+  uint32_t sequence;         // per sensor, from 0 when the driver starts
+  uint16_t sensor;           // the laser's ~udp_sensor_id
+  uint16_t num_ranges;
+  uint64_t host_stamp_ns;    // start of the scan, ROS time
+  uint64_t device_stamp_ns;  // from the laser's own clock; 0 if there isn't one
+  float scale;               // metres per raw reading
+  float angle_min;           // angle of reading 0, as in the LaserScan
+  float angle_increment;
+  float scan_time;
+};
+
+typedef char pls_udp_header_is_48_bytes[sizeof(PlsUdpHeader) == 48 ? 1 : -1];
+
+const size_t PLS_UDP_MAX_DATAGRAM = sizeof(PlsUdpHeader) + PLS_UDP_MAX_RANGES * sizeof(uint16_t);
+
+// "239.255.0.1:5800" to an address; IPv4 only, as multicast groups are
+// joined here.
+inline bool pls_udp_parse_address(const std::string &text, struct sockaddr_in &address)
+{
+  size_t colon = text.rfind(':');
+  if (colon == std::string::npos)
+    return false;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  int port = atoi(text.c_str() + colon + 1);
+  if (port <= 0 || port > 65535 || inet_aton(text.substr(0, colon).c_str(), &address.sin_addr) == 0)
+    return false;
+  address.sin_port = htons(port);
+  return true;
+}
+
+// The driver's side. Scans are queued with add() and sent together by
+// flush() in one sendmmsg, so several lasers published in the same pass
+// cost one system call. Never blocks; what the socket won't take is
+// dropped and counted.
+class PlsUdpSender : boost::noncopyable
+{
+public:
+  PlsUdpSender();
+  ~PlsUdpSender();
+
+  // destination is address:port, a multicast group or not. interface is
+  // the local address to send multicast from; empty for the default.
+  bool open(const std::string &destination, const std::string &interface = "", int ttl = 1,
+            bool loopback = true, size_t batch = 16);
+  void close();
+  bool isOpen() const { return fd_ >= 0; }
+
+  // Queues one scan; header's magic, version, header_size and num_ranges
+  // are filled in here. Flushes first if the batch is full.
+  void add(const PlsUdpHeader &header, const uint32_t *range_values, uint32_t n_range_values);
+  // Sends whatever has been queued.
+  void flush();
+
+  unsigned long sent() const { return sent_; }
+  unsigned long dropped() const { return dropped_; }
+  unsigned long flushes() const { return flushes_; }
+  const std::string &error() const { return error_; }
+
+private:
+  int fd_;
+  struct sockaddr_in destination_;
+  std::vector<uint8_t> buffers_; // batch datagrams of PLS_UDP_MAX_DATAGRAM
+  std::vector<struct mmsghdr> messages_;
+  std::vector<struct iovec> iovecs_;
+  size_t queued_;
+  unsigned long sent_;
+  unsigned long dropped_;
+  unsigned long flushes_;
+  std::string error_;
+};
+
+// A datagram decoded back to host byte order.
+struct PlsUdpScan
+{
+  PlsUdpHeader header;
+  uint16_t ranges[PLS_UDP_MAX_RANGES];
+};
+
+// The consumer's side; needs nothing but this header. Joins the group
+// (or just listens on the port, for unicast) and decodes what arrives.
+class PlsUdpReceiver : boost::noncopyable
+{
+public:
+  PlsUdpReceiver() : fd_(-1), received_(0), lost_(0), invalid_(0) {}
+  ~PlsUdpReceiver() { close(); }
+
+  // source is the address:port the driver sends to; interface is the local
+  // address to join the group on, empty for the default.
+  bool open(const std::string &source, const std::string &interface = "")
+  {
+    close();
+    struct sockaddr_in address;
+    if (!pls_udp_parse_address(source, address))
+      return fail("expected address:port, not " + source);
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0)
+      return fail(std::string("socket failed: ") + strerror(errno));
+    int on = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in local = address;
+    bool multicast = IN_MULTICAST(ntohl(address.sin_addr.s_addr));
+    if (!multicast)
+      local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd_, (struct sockaddr *)&local, sizeof(local)) < 0)
+      return fail("couldn't bind to " + source + ": " + strerror(errno));
+    if (multicast) {
+      struct ip_mreq request;
+      request.imr_multiaddr = address.sin_addr;
+      request.imr_interface.s_addr = htonl(INADDR_ANY);
+      if (!interface.empty() && inet_aton(interface.c_str(), &request.imr_interface) == 0)
+        return fail("expected an IPv4 address for the interface, not " + interface);
+      if (setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) < 0)
+        return fail("couldn't join " + source + ": " + strerror(errno));
+    }
+    return true;
+  }
+
+  void close()
+  {
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+    next_sequence_.clear();
+  }
+
+  bool isOpen() const { return fd_ >= 0; }
+  int fd() const { return fd_; }
+  const std::string &error() const { return error_; }
+
+  // Waits up to timeout seconds for a scan. Returns 1 for a scan, 0 on
+  // timeout and -1 on error. Datagrams that aren't scans are skipped.
+  int receive(PlsUdpScan &scan, double timeout)
+  {
+    uint8_t datagram[PLS_UDP_MAX_DATAGRAM + 1];
+    for (;;) {
+      struct pollfd pfd = { fd_, POLLIN, 0 };
+      int ready = poll(&pfd, 1, (int)(timeout * 1000));
+      if (ready < 0 && errno != EINTR) {
+        error_ = std::string("poll failed: ") + strerror(errno);
+        return -1;
+      }
+      if (ready <= 0)
+        return 0;
+      ssize_t n = recv(fd_, datagram, sizeof(datagram), 0);
+      if (n < 0) {
+        if (errno == EINTR || errno == EAGAIN)
+          continue;
+        error_ = std::string("recv failed: ") + strerror(errno);
+        return -1;
+      }
+      if (!decode(datagram, n, scan)) {
+        invalid_++;
+        continue;
+      }
+      received_++;
+      // Count the gap since this sensor's last scan; a restarted driver
+      // numbers from 0 again, which isn't a gap.
+      std::map<uint16_t, uint32_t>::iterator next = next_sequence_.find(scan.header.sensor);
+      if (next != next_sequence_.end() && scan.header.sequence > next->second)
+        lost_ += scan.header.sequence - next->second;
+      next_sequence_[scan.header.sensor] = scan.header.sequence + 1;
+      return 1;
+    }
+  }
+
+  static bool decode(const uint8_t *data, size_t size, PlsUdpScan &scan)
+  {
+    if (size < sizeof(PlsUdpHeader))
+      return false;
+    memcpy(&scan.header, data, sizeof(PlsUdpHeader));
+    PlsUdpHeader &h = scan.header;
+    h.magic = le32toh(h.magic);
+    h.version = le16toh(h.version);
+    h.header_size = le16toh(h.header_size);
+    h.sequence = le32toh(h.sequence);
+    h.sensor = le16toh(h.sensor);
+    h.num_ranges = le16toh(h.num_ranges);
+    h.host_stamp_ns = le64toh(h.host_stamp_ns);
+    h.device_stamp_ns = le64toh(h.device_stamp_ns);
+    h.scale = float_from_le(h.scale);
+    h.angle_min = float_from_le(h.angle_min);
+    h.angle_increment = float_from_le(h.angle_increment);
+    h.scan_time = float_from_le(h.scan_time);
+    // Later versions may only add to the header.
+    if (h.magic != PLS_UDP_MAGIC || h.version < PLS_UDP_VERSION || h.header_size < sizeof(PlsUdpHeader) ||
+        h.num_ranges > PLS_UDP_MAX_RANGES || size != h.header_size + h.num_ranges * sizeof(uint16_t))
+      return false;
+    memcpy(scan.ranges, data + h.header_size, h.num_ranges * sizeof(uint16_t));
+    for (uint32_t i = 0; i < h.num_ranges; i++)
+      scan.ranges[i] = le16toh(scan.ranges[i]);
+    return true;
+  }
+
+  unsigned long received() const { return received_; }
+  unsigned long lost() const { return lost_; }
+  unsigned long invalid() const { return invalid_; }
+
+private:
+  static float float_from_le(float value)
+  {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = le32toh(bits);
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  bool fail(const std::string &what)
+  {
+    error_ = what;
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+    return false;
+  }
+
+  int fd_;
+  std::map<uint16_t, uint32_t> next_sequence_;
+  unsigned long received_;
+  unsigned long lost_;
+  unsigned long invalid_;
+  std::string error_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
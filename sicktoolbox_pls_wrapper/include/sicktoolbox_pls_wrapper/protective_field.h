@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+// a protective field checked on raw readings through a per-reading threshold
+// table, and the UDP and GPIO outputs that signal it.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PROTECTIVE_FIELD_H
+#define SICKTOOLBOX_PLS_WRAPPER_PROTECTIVE_FIELD_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// A region around the laser, in its frame, that nothing may come into: a
+// polygon, any number of sectors, or both. Once the geometry is known it
+// comes down to a range of raw readings per reading, [near, far), that
+// count as inside, so checking a scan is one compare pair per reading.
+//
+// Along a reading's line of sight the polygon may be entered and left more
+// than once; the table keeps from where it's first entered to where it's
+// last left, which errs on the side of reporting an intrusion.
+class ProtectiveField
+{
+public:
+  ProtectiveField();
+
+  // x0, y0, x1, y1, ... in metres. Replaces any polygon set before.
+  void setPolygon(const std::vector<double> &xy);
+  // Readings between the angles (radians, either order) closer than range
+  // metres are inside.
+  void addSector(double angle_min, double angle_max, double range);
+  bool empty() const { return polygon_.empty() && sectors_.empty(); }
+
+  // Reading i is at first_angle + i * (last_angle - first_angle) / (n - 1)
+  // and raw readings are scale metres each. Builds the table for n
+  // readings; check() rebuilds it if scans turn out to have another size.
+  void configure(uint32_t n, double first_angle, double last_angle, double scale);
+
+  // Number of valid readings inside the field. Out-of-range codes and 0
+  // never are.
+  uint32_t check(const uint32_t *range_values, uint32_t n);
+
+  // The table, for diagnostics and tests: raw readings r with
+  // near(i) <= r < far(i) are inside.
+  uint32_t size() const { return far_.size(); }
+  uint32_t near(uint32_t i) const { return near_[i]; }
+  uint32_t far(uint32_t i) const { return far_[i]; }
+
+private:
+  // The extent of the field along the line of sight at angle, in metres;
+  // false if it never crosses it.
+  bool extent(double angle, double &near, double &far) const;
+
+  struct Sector
+  {
+    double angle_min, angle_max, range;
+  };
+
+  std::vector<double> polygon_;
+  std::vector<Sector> sectors_;
+  double first_angle_;
+  double last_angle_;
+  double scale_;
+  std::vector<uint32_t> near_;
+  std::vector<uint32_t> far_;
+};
+
+// Tells something outside ROS when the field changes state: a UDP datagram
+// to a host:port, and/or "1" or "0" written to a file such as a sysfs GPIO
+// value. Both are non-blocking, so they can run on the thread that reads
+// the laser. The datagram is ProtectiveFieldPacket, little-endian.
+struct ProtectiveFieldPacket
+{
+  enum { MAGIC = 0x46534c50 }; // "PLSF" on the wire
+
+  uint32_t magic;
+  uint32_t sequence;   // one per state change
+  uint64_t stamp_ns;   // when the scan that changed it was read, in ROS time
+  uint8_t intruded;
+  uint8_t reserved[3];
+  uint32_t readings;   // how many readings were inside
+};
+
+class ProtectiveFieldSignal : boost::noncopyable
+{
+public:
+  ProtectiveFieldSignal();
+  ~ProtectiveFieldSignal();
+
+  // Either may be empty. Returns false, with error() set, if one of them
+  // couldn't be opened; the other is still used. error() is only written
+  // here.
+  bool open(const std::string &udp_target, const std::string &gpio_file);
+  void close();
+  bool isOpen() const { return udp_fd_ >= 0 || gpio_fd_ >= 0; }
+
+  // Sends the new state. Returns false, and counts a failure, if a send
+  // failed; signalling goes on with the next change regardless.
+  bool signal(bool intruded, uint64_t stamp_ns, uint32_t readings);
+
+  const std::string &error() const { return error_; }
+  unsigned long failures() const { return failures_; }
+
+private:
+  int udp_fd_;
+  int gpio_fd_;
+  uint32_t sequence_;
+  unsigned long failures_;
+  std::string error_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
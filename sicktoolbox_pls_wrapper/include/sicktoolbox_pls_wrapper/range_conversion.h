@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// conversion of raw PLS range readings to the floats that go into a
+// LaserScan, with SSE2/AVX2/NEON kernels picked at runtime.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_RANGE_CONVERSION_H
+#define SICKTOOLBOX_PLS_WRAPPER_RANGE_CONVERSION_H
+
+#include <cstddef>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Raw readings above this are the PLS's out-of-range codes (5105, 5110, ...)
+// rather than distances. The PLS tops out at 50m in cm units.
+const uint32_t PLS_MAX_VALID_RANGE = 5000;
+
+enum RangeKernelIsa
+{
+  RANGE_KERNEL_SCALAR,
+  RANGE_KERNEL_SSE2,
+  RANGE_KERNEL_AVX2,
+  RANGE_KERNEL_NEON,
+  RANGE_KERNEL_COUNT
+};
+
+// The PLS reports in cm or mm. Converters picked for those have the scale
+// compiled in; RANGE_UNITS_OTHER takes it as an argument.
+enum RangeUnits
+{
+  RANGE_UNITS_CM,    // 0.01 m per reading
+  RANGE_UNITS_MM,    // 0.001 m per reading
+  RANGE_UNITS_OTHER
+};
+
+// n raw readings to metres, as convert_ranges() would convert them for the
+// units, direction and masking the converter was picked for. scale is only
+// read by RANGE_UNITS_OTHER converters.
+typedef void (*RangeConverter)(const uint32_t *in, float *out, size_t n, float scale);
+
+// The units a scale stands for, with some slack for doubles that went
+// through a float or a parameter server on the way.
+RangeUnits range_units(double scale);
+
+// Converts n raw readings to metres in one pass:
+//   out[i] = in[i] * scale            (in[n-1-i] when reverse is set)
+// and, when mask_out_of_range is set, readings above PLS_MAX_VALID_RANGE
+// become +Inf as REP 117 asks for. Raw readings are assumed to fit in 16
+// bits, as they do on the wire. in and out must not overlap.
+void convert_ranges(const uint32_t *in, float *out, size_t n, float scale,
+                    bool reverse, bool mask_out_of_range);
+
+// The same conversion through a specific kernel, for benchmarks. Falls back
+// to the scalar kernel if isa isn't available on this machine.
+void convert_ranges(RangeKernelIsa isa, const uint32_t *in, float *out, size_t n,
+                    float scale, bool reverse, bool mask_out_of_range);
+
+// The conversion with everything that is fixed for a laser configuration
+// baked in, through the best kernel on this machine: no per-scan branches
+// on the configuration, and loops the compiler can unroll. Pick it once the
+// laser has told us its units and call it for every scan.
+RangeConverter select_range_converter(RangeUnits units, bool reverse, bool mask_out_of_range);
+
+// The same through a specific kernel, for benchmarks; falls back to the
+// scalar kernel as convert_ranges() does.
+RangeConverter select_range_converter(RangeKernelIsa isa, RangeUnits units, bool reverse,
+                                      bool mask_out_of_range);
+
+// Kernel that convert_ranges() uses on this machine.
+RangeKernelIsa selected_range_kernel();
+
+bool range_kernel_available(RangeKernelIsa isa);
+
+const char *range_kernel_name(RangeKernelIsa isa);
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
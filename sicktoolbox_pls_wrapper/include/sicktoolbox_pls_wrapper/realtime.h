@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+// CPU affinity, SCHED_FIFO and memory locking for the driver's threads.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_REALTIME_H
+#define SICKTOOLBOX_PLS_WRAPPER_REALTIME_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Linux thread id of the calling thread.
+pid_t current_thread_id();
+
+// Ids of every thread in this process, sorted.
+std::vector<pid_t> process_thread_ids();
+
+// Parses a CPU list like "2", "0,2" or "1-3". Returns false if it isn't one.
+bool parse_cpu_list(const std::string &list, std::vector<int> &cpus);
+
+// What tune_thread() asked for and what the kernel actually granted.
+struct ThreadTuning
+{
+  ThreadTuning() : tid(0), priority(0), affinity_set(false), realtime(false) {}
+
+  pid_t tid;
+  std::vector<int> cpus; // requested; empty leaves the affinity alone
+  int priority;          // requested SCHED_FIFO priority; 0 leaves the policy alone
+  bool affinity_set;
+  bool realtime;         // running SCHED_FIFO, as read back from the kernel
+  std::string error;     // why not, when something wasn't granted
+
+  bool requested() const { return !cpus.empty() || priority > 0; }
+  bool granted() const { return (cpus.empty() || affinity_set) && (priority <= 0 || realtime); }
+  // e.g. "SCHED_FIFO 80 on CPU 2"
+  std::string describe() const;
+};
+
+// Pins thread tid to cpus and, for priority > 0, switches it to SCHED_FIFO
+// at that priority. Needs CAP_SYS_NICE or an rtprio limit for the latter.
+ThreadTuning tune_thread(pid_t tid, const std::vector<int> &cpus, int priority);
+
+// mlockall(MCL_CURRENT | MCL_FUTURE), so that nothing the driver touches
+// is paged out from under it. Needs CAP_IPC_LOCK or a big enough memlock
+// limit.
+bool lock_memory(std::string &error);
+
+// Touches bytes of the calling thread's stack, so that even deep calls
+// don't fault once the loop is running.
+void prefault_stack(size_t bytes);
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////
+// delta compression of raw PLS scans against the scan before them, for
+// sending scans over links with little bandwidth.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_SCAN_DELTA_H
+#define SICKTOOLBOX_PLS_WRAPPER_SCAN_DELTA_H
+
+#include <cstddef>
+#include <vector>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// A compressed scan is one of two kinds of frame, both built from unsigned
+// LEB128 varints and zigzag-coded signed varints:
+//
+//   keyframe: every reading, as the zigzag difference from the reading
+//             before it (the first from 0).
+//   delta:    for each run of changed readings, the number of unchanged
+//             readings before it, the number in it, and then each one's
+//             zigzag difference from the previous frame. Unchanged readings
+//             after the last run aren't sent.
+//
+// Frames are numbered; a delta only applies to the frame numbered one
+// before it, so a decoder that misses a frame waits for the next keyframe.
+// With a deadband of 0 the coding is lossless.
+
+enum ScanDeltaFrame
+{
+  SCAN_DELTA_UNCHANGED, // nothing worth sending
+  SCAN_DELTA_DELTA,
+  SCAN_DELTA_KEYFRAME
+};
+
+class ScanDeltaEncoder
+{
+public:
+  // A keyframe goes out at least every keyframe_interval scans. Readings
+  // within deadband raw units of what the decoder last got count as
+  // unchanged.
+  ScanDeltaEncoder(uint32_t keyframe_interval, uint32_t deadband);
+
+  // Codes n readings into data and says what kind of frame that is. For
+  // SCAN_DELTA_UNCHANGED data is left empty and the frame number doesn't
+  // advance; nothing needs sending.
+  ScanDeltaFrame encode(const uint32_t *range_values, uint32_t n, std::vector<uint8_t> &data);
+
+  // Makes the next frame a keyframe, e.g. for a new subscriber.
+  void requestKeyframe() { keyframe_requested_ = true; }
+
+  // Number of the frame encode() last produced.
+  uint32_t frame() const { return frame_; }
+
+private:
+  // Returns false if nothing changed.
+  bool encodeDelta(const uint32_t *range_values, uint32_t n, std::vector<uint8_t> &data);
+
+  uint32_t keyframe_interval_;
+  uint32_t deadband_;
+  std::vector<uint32_t> reference_; // what the decoder has now
+  std::vector<uint8_t> keyframe_; // scratch for when a keyframe comes out smaller
+  uint32_t since_keyframe_;
+  uint32_t frame_;
+  bool keyframe_requested_;
+};
+
+class ScanDeltaDecoder
+{
+public:
+  ScanDeltaDecoder();
+
+  // Applies a frame. Returns false, and waits for a keyframe, if the frame
+  // is malformed or is a delta against a frame we don't have.
+  bool decode(bool keyframe, uint32_t frame, uint32_t n, const uint8_t *data, size_t size);
+
+  // The readings as of the last frame decoded.
+  const uint32_t *rangeValues() const { return values_.empty() ? NULL : &values_[0]; }
+  uint32_t size() const { return values_.size(); }
+  bool synchronized() const { return synchronized_; }
+
+  // Frames thrown away waiting for a keyframe.
+  unsigned long dropped() const { return dropped_; }
+
+private:
+  std::vector<uint32_t> values_;
+  uint32_t frame_;
+  bool synchronized_;
+  unsigned long dropped_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////
+// filters that run on raw PLS readings before they're published.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_SCAN_FILTERS_H
+#define SICKTOOLBOX_PLS_WRAPPER_SCAN_FILTERS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include "pls_scan.h"
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// What a filter writes over a reading it throws away. It's above
+// PLS_MAX_VALID_RANGE, so it publishes as out of range (+Inf under REP 117).
+const uint32_t SCAN_FILTER_REMOVED = 0x1fff;
+
+// A filter works in place on one scan of raw readings. Everything it needs
+// is allocated when it's built for at most max_values readings per scan, so
+// filtering never allocates.
+class ScanFilter : boost::noncopyable
+{
+public:
+  virtual ~ScanFilter() {}
+  virtual const char *name() const = 0;
+  virtual void apply(uint32_t *values, uint32_t n) = 0;
+  // Forget any history, e.g. after a reconnect.
+  virtual void reset() {}
+};
+
+// Median of each reading over the last window scans. Each reading keeps its
+// last window values twice over, in arrival order (to know which one to drop)
+// and sorted (to find the median), both stored per reading so that each
+// reading's history is contiguous. Updating a reading is then one removal
+// and one insertion into a short sorted run.
+class TemporalMedianFilter : public ScanFilter
+{
+public:
+  TemporalMedianFilter(uint32_t window, uint32_t max_values);
+  const char *name() const { return "temporal_median"; }
+  void apply(uint32_t *values, uint32_t n);
+  void reset();
+
+private:
+  uint32_t window_;
+  uint32_t max_values_;
+  uint32_t n_;     // readings per scan of the history; it restarts if that changes
+  uint32_t count_; // scans in the history, up to window_
+  uint32_t next_;  // slot the next scan overwrites
+  std::vector<uint32_t> arrivals_; // [reading][slot]
+  std::vector<uint32_t> sorted_;   // [reading][rank]
+};
+
+// Median of each reading and its neighbours, window readings wide, where the
+// window is cut short at the ends of the scan.
+class SpatialMedianFilter : public ScanFilter
+{
+public:
+  SpatialMedianFilter(uint32_t window, uint32_t max_values);
+  const char *name() const { return "spatial_median"; }
+  void apply(uint32_t *values, uint32_t n);
+
+private:
+  uint32_t half_;
+  std::vector<uint32_t> input_;
+};
+
+// Removes veiling points: the spurious readings between a near edge and the
+// background behind it. Reading pairs up to window apart that make an angle
+// outside [min_angle, max_angle] (radians) with the line of sight are taken
+// to straddle an edge, and the farther of the two is removed.
+class ShadowFilter : public ScanFilter
+{
+public:
+  ShadowFilter(double min_angle, double max_angle, uint32_t window,
+               double angle_increment, uint32_t max_values);
+  const char *name() const { return "shadow"; }
+  void apply(uint32_t *values, uint32_t n);
+
+private:
+  uint32_t window_;
+  double sin_min_, cos_min_, sin_max_, cos_max_;
+  std::vector<double> sin_step_; // sin/cos of k angle increments, k = 1..window
+  std::vector<double> cos_step_;
+  std::vector<uint32_t> input_;
+};
+
+// The filters in the order they run.
+class ScanFilterChain
+{
+public:
+  void add(const boost::shared_ptr<ScanFilter> &filter) { filters_.push_back(filter); }
+  bool empty() const { return filters_.empty(); }
+  size_t size() const { return filters_.size(); }
+  const ScanFilter &operator[](size_t i) const { return *filters_[i]; }
+
+  void apply(uint32_t *values, uint32_t n)
+  {
+    for (size_t i = 0; i < filters_.size(); i++)
+      filters_[i]->apply(values, n);
+  }
+  // Keeps INVALID in step with what the filters left, so a reading one
+  // removed is masked out of the status too; the PLS's own flags stay.
+  void apply(PlsScan &scan)
+  {
+    apply(scan.ranges, scan.size);
+    if (!(scan.fields & PlsScan::STATUS))
+      return;
+    for (uint32_t i = 0; i < scan.size; i++) {
+      if (scan.ranges[i] > PLS_MAX_VALID_RANGE)
+        scan.status[i] |= PlsScan::INVALID;
+      else
+        scan.status[i] &= ~PlsScan::INVALID;
+    }
+  }
+  void reset()
+  {
+    for (size_t i = 0; i < filters_.size(); i++)
+      filters_[i]->reset();
+  }
+
+private:
+  std::vector<boost::shared_ptr<ScanFilter> > filters_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+// the last few seconds of scans, kept for lookups by time.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_SCAN_HISTORY_H
+#define SICKTOOLBOX_PLS_WRAPPER_SCAN_HISTORY_H
+
+#include <cstddef>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <pthread.h>
+#include "pls_scan.h"
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// A fixed number of the newest scans, copied into buffers allocated up
+// front, with their stamps in a column of their own so that finding a time
+// is a binary search over 8-byte keys rather than a walk through 2.5 KB
+// scans. One copy of a laser's recent past that every consumer can ask
+// instead of keeping its own.
+//
+// add() and the lookups may be called from different threads. The lookups
+// hand each scan they find to a visitor with the history locked, so the
+// scans need not be copied again, but the producer waits for the visitor:
+// keep it to a conversion. The lock inherits priority, as PlsScanPool's
+// does.
+class ScanHistory : boost::noncopyable
+{
+public:
+  // Called with each scan found, oldest first, and the stamp it was added with.
+  typedef boost::function<void (const PlsScan &, uint64_t)> Visitor;
+
+  explicit ScanHistory(size_t capacity);
+  ~ScanHistory();
+
+  size_t capacity() const { return capacity_; }
+  size_t size();
+
+  // Copies scan in as the newest, at stamp_ns. A stamp before the newest
+  // means the clock went back (a reconnect, or sim time restarting), and
+  // the history starts over from this scan.
+  void add(const PlsScan &scan, uint64_t stamp_ns);
+  void clear();
+
+  // The lookups visit the scans they find and return how many that was.
+  //
+  // The one scan stamped closest to stamp_ns; the earlier one on a tie.
+  size_t nearest(uint64_t stamp_ns, const Visitor &visit);
+  // The newest scan at or before stamp_ns and the oldest after it, or just
+  // the one of them there is when stamp_ns is outside the history.
+  size_t bracket(uint64_t stamp_ns, const Visitor &visit);
+  // The newest n scans, or all of them if there are fewer.
+  size_t latest(size_t n, const Visitor &visit);
+
+  // The stamps of the oldest and newest scans, if there are any.
+  bool span(uint64_t &oldest_ns, uint64_t &newest_ns);
+
+  // Scans added, and times the history started over.
+  unsigned long added() const { return added_; }
+  unsigned long restarts() const { return restarts_; }
+
+private:
+  // Slot of the i-th oldest scan. Callers hold the lock.
+  size_t slot(size_t i) const { return (first_ + i) % capacity_; }
+  // How many of the held scans are stamped at or before stamp_ns.
+  size_t countUpTo(uint64_t stamp_ns) const;
+  void visitRange(size_t begin, size_t end, const Visitor &visit) const;
+
+  PlsScan *scans_;
+  uint64_t *stamps_;
+  size_t capacity_;
+  size_t first_;
+  size_t size_;
+  pthread_mutex_t mutex_;
+  volatile unsigned long added_;
+  volatile unsigned long restarts_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
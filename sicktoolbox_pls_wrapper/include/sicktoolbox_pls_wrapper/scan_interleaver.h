@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// merges interleaved partial scans into one full-resolution scan.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_SCAN_INTERLEAVER_H
+#define SICKTOOLBOX_PLS_WRAPPER_SCAN_INTERLEAVER_H
+
+#include <cstddef>
+#include <vector>
+#include <boost/noncopyable.hpp>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Interleaved scanning spreads one sweep's worth of resolution over factor
+// consecutive scans, each starting 1/factor of a reading's angle after the
+// one before. Reading i of the k'th scan of a set is reading i * factor + k
+// of the merged scan; readings of the later scans past the end of the
+// first's field of view are left out, so n readings per scan merge into
+// (n - 1) * factor + 1.
+//
+// Scans don't say which phase they are, so a set is taken to be factor
+// scans in a row with no frame missing between them. Anything that breaks
+// that (a gap longer than maxGap, a change in the number of readings, a
+// reset) starts a new set and counts the partial one as broken.
+class ScanInterleaver : boost::noncopyable
+{
+public:
+  // max_values is the most readings a partial scan has.
+  ScanInterleaver(uint32_t factor, uint32_t max_values);
+
+  uint32_t factor() const { return factor_; }
+  // The most readings a merged scan has.
+  uint32_t capacity() const { return merged_.size(); }
+
+  // Scans further apart than this aren't consecutive; 0 never checks.
+  void setMaxGap(uint64_t ns) { max_gap_ns_ = ns; }
+
+  // Adds the next scan, stamped at its start. Returns true if it completed
+  // a set; the merged scan is then values() until the next add().
+  bool add(const uint32_t *values, uint32_t n, uint64_t stamp_ns);
+  const uint32_t *values() const { return &merged_[0]; }
+  uint32_t size() const { return size_; }
+  // When the first scan of the merged set started.
+  uint64_t stamp() const { return stamp_ns_; }
+
+  void reset();
+
+  unsigned long merged() const { return merged_count_; }
+  unsigned long broken() const { return broken_count_; }
+
+private:
+  uint32_t factor_;
+  uint32_t max_values_;
+  uint64_t max_gap_ns_;
+  uint32_t phase_;     // scans of the current set so far
+  uint32_t n_;         // readings per scan of the current set
+  uint64_t last_ns_;   // stamp of the last scan added
+  uint64_t stamp_ns_;
+  uint32_t size_;
+  std::vector<uint32_t> merged_;
+  unsigned long merged_count_;
+  unsigned long broken_count_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// projection of raw PLS readings to points in the scan plane, for
+// publishing point clouds straight from the driver.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_SCAN_PROJECTION_H
+#define SICKTOOLBOX_PLS_WRAPPER_SCAN_PROJECTION_H
+
+#include <cstddef>
+#include <vector>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Turns readings into x, y, z points using the cos and sin of every
+// reading's angle, worked out once for the laser's fixed geometry.
+class ScanProjector
+{
+public:
+  // x, y, z and 4 bytes of padding per point, like pcl::PointXYZ
+  static const size_t POINT_STEP = 16;
+
+  ScanProjector();
+
+  // Reading i is at angle_min + i * angle_increment.
+  void configure(uint32_t n_range_values, float angle_min, float angle_increment);
+  uint32_t size() const { return cos_.size(); }
+
+  // Writes POINT_STEP bytes per reading to points, which needn't be
+  // aligned, and returns the number of points written. Readings over
+  // PLS_MAX_VALID_RANGE are NaN points or, if dense is set, left out.
+  // Projects no more than size() readings.
+  uint32_t project(const uint32_t *range_values, uint32_t n_range_values, float scale,
+                   bool dense, float *points) const;
+
+private:
+  std::vector<float> cos_;
+  std::vector<float> sin_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,181 @@
+///////////////////////////////////////////////////////////////////////////////
+// a bounded single-producer/single-consumer ring used to hand scans from the
+// thread that talks to the laser to the thread that publishes them.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_SCAN_RING_H
+#define SICKTOOLBOX_PLS_WRAPPER_SCAN_RING_H
+
+#include <cstddef>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// What the producer does when it has a new scan and the ring is full.
+enum OverflowPolicy
+{
+  DROP_OLDEST, // overwrite the oldest queued scan; readers always see the freshest data
+  DROP_NEWEST  // keep the queued scans and discard the new one
+};
+
+// Lock-free SPSC ring of fixed-size, plain-old-data slots.
+//
+// The producer fills a slot in place (beginPush/commitPush) so a scan can be
+// read straight from the device into the ring. The consumer copies a slot out
+// with pop(). Under DROP_OLDEST the producer reclaims the oldest slot by
+// advancing the tail itself; the consumer detects that race through a failed
+// compare-and-swap on the tail and retries, so T must be safe to copy while it
+// is being overwritten (i.e. a POD or a POD pointer).
+//
+// Exactly one thread may call beginPush/commitPush and exactly one thread may
+// call pop. The counters are written by the producer only and may be read
+// from any thread.
+template <typename T>
+class ScanRing : boost::noncopyable
+{
+public:
+  explicit ScanRing(size_t capacity, OverflowPolicy policy = DROP_OLDEST)
+    : policy_(policy), head_(0), tail_(0), pushed_(0), dropped_(0)
+  {
+    size_t n = 1;
+    while (n < capacity)
+      n <<= 1;
+    mask_ = n - 1;
+    // One extra slot past the ring is the scratch slot that DROP_NEWEST
+    // writes into when the ring is full.
+    slots_.resize(n + 1);
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+  OverflowPolicy policy() const { return policy_; }
+
+  // Producer: returns the slot that the next scan should be written into.
+  // Never fails; if the ring is full the overflow policy decides which scan
+  // is lost and the loss is counted when the slot is committed.
+  T *beginPush()
+  {
+    size_t head = head_;
+    size_t tail = tail_;
+    if (head - tail <= mask_)
+    {
+      scratch_ = false;
+      return &slots_[head & mask_];
+    }
+    if (policy_ == DROP_NEWEST)
+    {
+      scratch_ = true;
+      return &slots_[mask_ + 1];
+    }
+    // Claim the oldest slot before touching it. If the consumer got there
+    // first the ring is no longer full and the CAS failing is harmless.
+    if (__sync_bool_compare_and_swap(&tail_, tail, tail + 1))
+      ++dropped_;
+    scratch_ = false;
+    return &slots_[head & mask_];
+  }
+
+  // Producer: makes the slot returned by beginPush visible to the consumer.
+  void commitPush()
+  {
+    ++pushed_;
+    if (scratch_)
+    {
+      ++dropped_;
+      return;
+    }
+    __sync_synchronize(); // slot contents before the new head
+    head_ = head_ + 1;
+  }
+
+  // Producer: queues value in one go, for rings of pointers whose owner has
+  // to take back whatever the ring gives up. Returns true if that cost a
+  // scan, and sets lost to it: the oldest queued one under DROP_OLDEST, or
+  // value itself under DROP_NEWEST.
+  bool push(const T &value, T &lost)
+  {
+    unsigned long dropped = dropped_;
+    T *slot = beginPush();
+    bool evicted = dropped_ != dropped;
+    if (evicted)
+      lost = *slot; // claimed from the consumer by beginPush, so ours now
+    *slot = value;
+    commitPush();
+    if (scratch_)
+    {
+      lost = value;
+      return true;
+    }
+    return evicted;
+  }
+
+  // Consumer: copies the oldest scan into out. Returns false if empty.
+  bool pop(T &out)
+  {
+    for (;;)
+    {
+      size_t tail = tail_;
+      size_t head = head_;
+      if (tail == head)
+        return false;
+      __sync_synchronize(); // head before the slot contents
+      out = slots_[tail & mask_];
+      if (__sync_bool_compare_and_swap(&tail_, tail, tail + 1))
+        return true;
+      // The producer dropped this slot while we were copying it; retry.
+    }
+  }
+
+  bool empty() const { return head_ == tail_; }
+  size_t size() const { return head_ - tail_; }
+
+  // Scans offered by the producer, including the ones that were dropped.
+  unsigned long pushed() const { return pushed_; }
+  // Scans lost to the overflow policy.
+  unsigned long dropped() const { return dropped_; }
+
+private:
+  // Keep the producer- and consumer-owned indices on separate cache lines.
+  enum { CACHE_LINE = 64 };
+
+  std::vector<T> slots_;
+  size_t mask_;
+  OverflowPolicy policy_;
+  bool scratch_;
+  char pad0_[CACHE_LINE];
+  volatile size_t head_;
+  char pad1_[CACHE_LINE - sizeof(size_t)];
+  volatile size_t tail_;
+  char pad2_[CACHE_LINE - sizeof(size_t)];
+  volatile unsigned long pushed_;
+  volatile unsigned long dropped_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+// estimates when each PLS scan was actually taken from when the serial
+// read returned, removing the transfer time and the host's scheduling jitter.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_SCAN_TIMESTAMPER_H
+#define SICKTOOLBOX_PLS_WRAPPER_SCAN_TIMESTAMPER_H
+
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// The PLS sends a measured-values telegram once it has finished sweeping
+// the field, and telegrams start on scan boundaries, so first bytes arrive
+// on a regular grid. What the host sees (the time the read returned) is that
+// grid plus the telegram's transfer time plus a non-negative scheduling
+// delay.
+//
+// ScanTimestamper subtracts the modelled transfer time to get the arrival
+// of the first byte, then runs a minimum-delay phase-locked filter over
+// successive frames: a frame arriving earlier than predicted pulls the
+// estimate straight down to it, one arriving later only nudges it up, and
+// the frame period is measured along that envelope to follow the drift
+// between the laser's clock and ours.
+// The filtered first-byte times therefore ride the lower envelope of the
+// observations, which is where the undelayed frames are.
+//
+// All times are in seconds on the host clock.
+class ScanTimestamper
+{
+public:
+  // scan_time is the mirror period (1/75 s); baud is the serial rate.
+  ScanTimestamper(double scan_time, uint32_t baud);
+
+  // Seconds to move a measured-values telegram with n_range_values readings.
+  static double transferTime(uint32_t baud, uint32_t n_range_values);
+
+  // The serial link carries one telegram per this many seconds: a whole
+  // number of scan periods long enough to fit the transfer.
+  static double framePeriod(double scan_time, uint32_t baud, uint32_t n_range_values);
+
+  // Returns the estimated start time of the scan whose read returned at
+  // read_return_time.
+  double stamp(double read_return_time, uint32_t n_range_values);
+
+  // Forget the filter state, e.g. after a reconnect.
+  void reset();
+
+  void setBaud(uint32_t baud) { baud_ = baud; reset(); }
+
+  // Filter state, for diagnostics.
+  double period() const { return period_; }
+  // Mean of how much later than the envelope frames were read.
+  double meanDelay() const { return mean_delay_; }
+  unsigned long resets() const { return resets_; }
+
+private:
+  double scan_time_;
+  uint32_t baud_;
+  bool locked_;
+  double predicted_;   // filtered first-byte time of the last frame
+  double period_;      // filtered frame period
+  double mean_delay_;
+  unsigned long frames_;  // grid points since lock
+  double anchor_time_; // start of the period baseline
+  unsigned long anchor_frames_;
+  unsigned long resets_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
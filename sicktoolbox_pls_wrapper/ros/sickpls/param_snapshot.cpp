@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// a namespace's parameters fetched in one round trip.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "param_snapshot.h"
+
+ParamSnapshot::ParamSnapshot(const ros::NodeHandle &nh)
+{
+  if (!nh.getParam(nh.getNamespace(), values_) ||
+      values_.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+    values_ = XmlRpc::XmlRpcValue();
+}
+
+ParamSnapshot ParamSnapshot::child(const std::string &name) const
+{
+  ParamSnapshot snapshot;
+  if (hasParam(name) && values_[name].getType() == XmlRpc::XmlRpcValue::TypeStruct)
+    snapshot.values_ = values_[name];
+  return snapshot;
+}
+
+bool ParamSnapshot::hasParam(const std::string &name) const
+{
+  return values_.getType() == XmlRpc::XmlRpcValue::TypeStruct && values_.hasMember(name);
+}
+
+bool ParamSnapshot::getParam(const std::string &name, XmlRpc::XmlRpcValue &value) const
+{
+  if (!hasParam(name))
+    return false;
+  value = values_[name];
+  return true;
+}
+
+bool ParamSnapshot::getParam(const std::string &name, std::string &value) const
+{
+  if (!hasParam(name) || values_[name].getType() != XmlRpc::XmlRpcValue::TypeString)
+    return false;
+  value = static_cast<std::string>(values_[name]);
+  return true;
+}
+
+bool ParamSnapshot::getParam(const std::string &name, double &value) const
+{
+  if (!hasParam(name))
+    return false;
+  XmlRpc::XmlRpcValue &v = values_[name];
+  if (v.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    value = static_cast<double>(v);
+  else if (v.getType() == XmlRpc::XmlRpcValue::TypeInt)
+    value = static_cast<int>(v);
+  else
+    return false;
+  return true;
+}
+
+bool ParamSnapshot::getParam(const std::string &name, int &value) const
+{
+  if (!hasParam(name) || values_[name].getType() != XmlRpc::XmlRpcValue::TypeInt)
+    return false;
+  value = static_cast<int>(values_[name]);
+  return true;
+}
+
+bool ParamSnapshot::getParam(const std::string &name, bool &value) const
+{
+  if (!hasParam(name) || values_[name].getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+    return false;
+  value = static_cast<bool>(values_[name]);
+  return true;
+}
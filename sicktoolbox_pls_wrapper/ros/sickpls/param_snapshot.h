@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// a namespace's parameters fetched from the parameter server in one
+// round trip and looked up locally after that.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PARAM_SNAPSHOT_H
+#define SICKTOOLBOX_PLS_WRAPPER_PARAM_SNAPSHOT_H
+
+#include <string>
+#include "ros/ros.h"
+
+// Stands in for a NodeHandle when loading configuration. Every lookup on a
+// NodeHandle is a call to the master, which adds up to seconds of startup
+// when the master is remote and there are a few dozen parameters; this
+// fetches the whole namespace once. Values are converted the way roscpp
+// converts them: an int will do for a double, and nothing else is coerced.
+class ParamSnapshot
+{
+public:
+  ParamSnapshot() {}
+  // Everything under nh's namespace, e.g. "~".
+  explicit ParamSnapshot(const ros::NodeHandle &nh);
+
+  // The parameters under name/, e.g. one laser's under ~devices.
+  ParamSnapshot child(const std::string &name) const;
+
+  bool hasParam(const std::string &name) const;
+  bool getParam(const std::string &name, XmlRpc::XmlRpcValue &value) const;
+  bool getParam(const std::string &name, std::string &value) const;
+  bool getParam(const std::string &name, double &value) const;
+  bool getParam(const std::string &name, int &value) const;
+  bool getParam(const std::string &name, bool &value) const;
+
+  template<class T>
+  void param(const std::string &name, T &value, const T &default_value) const
+  {
+    if (!getParam(name, value))
+      value = default_value;
+  }
+
+private:
+  // XmlRpcValue only has non-const lookups.
+  mutable XmlRpc::XmlRpcValue values_; // a struct, or invalid if there were none
+};
+
+#endif
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+// turns the driver's delta-compressed scans back into LaserScans at the
+// far end of a slow link.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include <sicktoolbox_pls_wrapper/CompressedScan.h>
+#include <sicktoolbox_pls_wrapper/scan_delta.h>
+#include "scan_publisher.h"
+using namespace sicktoolbox_pls_wrapper;
+
+class Decompressor
+{
+public:
+  Decompressor(ros::NodeHandle &nh)
+    : last_dropped_(0)
+  {
+    scan_pub_ = nh.advertise<sensor_msgs::LaserScan>("scan", 10);
+    compressed_sub_ = nh.subscribe("scan_compressed", 10, &Decompressor::compressedCallback, this);
+  }
+
+private:
+  void compressedCallback(const CompressedScanConstPtr &msg)
+  {
+    if (!decoder_.decode(msg->keyframe, msg->frame, msg->num_ranges,
+                         msg->data.empty() ? NULL : &msg->data[0], msg->data.size())) {
+      if (decoder_.dropped() - last_dropped_ == 1)
+        ROS_WARN("Missed a compressed scan; waiting for the next keyframe.");
+      return;
+    }
+    last_dropped_ = decoder_.dropped();
+    fill_scan_from_compressed(scan_msg_, *msg, decoder_.rangeValues());
+    scan_pub_.publish(scan_msg_);
+  }
+
+  ros::Publisher scan_pub_;
+  ros::Subscriber compressed_sub_;
+  ScanDeltaDecoder decoder_;
+  unsigned long last_dropped_;
+  sensor_msgs::LaserScan scan_msg_;
+};
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "pls_decompress");
+  ros::NodeHandle nh;
+  load_use_rep_117(nh);
+  Decompressor decompressor(nh);
+  ros::spin();
+  return 0;
+}
@@ -0,0 +1,1293 @@
+///////////////////////////////////////////////////////////////////////////////
+// one PLS as the driver sees it: probing, reading and publishing a single laser.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+#include <boost/bind.hpp>
+#include "diagnostic_msgs/DiagnosticArray.h"
+#include "std_msgs/Bool.h"
+#include "pls_device.h"
+using namespace SickToolbox;
+using namespace sicktoolbox_pls_wrapper;
+
+ScanReader::ScanReader(const ReadFunction &read, size_t queue_size, OverflowPolicy policy)
+  : read_(read), ring_(queue_size, policy),
+    // Every slot of the ring, the scan being read and the one being published
+    pool_(ring_.capacity() + 2), running_(false), failed_(false)
+{
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd_ < 0)
+    ROS_ERROR("Unable to create the scan queue eventfd: %s", strerror(errno));
+}
+
+ScanReader::~ScanReader()
+{
+  stop();
+  if (event_fd_ >= 0)
+    close(event_fd_);
+}
+
+void ScanReader::start()
+{
+  running_ = true;
+  thread_ = boost::thread(&ScanReader::run, this);
+}
+
+void ScanReader::stop()
+{
+  running_ = false;
+  thread_.join();
+}
+
+bool ScanReader::pop(PlsScan *&scan)
+{
+  if (ring_.pop(scan))
+    return true;
+  // Only clear the eventfd once the ring looks empty, then look again so a
+  // scan pushed in between isn't left waiting for the next one.
+  uint64_t count;
+  if (read(event_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    ROS_WARN_ONCE("Reading the scan queue eventfd failed: %s", strerror(errno));
+  return ring_.pop(scan);
+}
+
+bool ScanReader::waitForScan(PlsScan *&scan, int timeout_ms)
+{
+  if (pop(scan))
+    return true;
+  if (!running_ || failed_)
+    return false;
+  struct pollfd pfd;
+  pfd.fd = event_fd_;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  if (poll(&pfd, 1, timeout_ms) <= 0)
+    return false;
+  return pop(scan);
+}
+
+void ScanReader::signal()
+{
+  uint64_t one = 1;
+  if (write(event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    ROS_WARN_ONCE("Signalling the scan queue eventfd failed: %s", strerror(errno));
+}
+
+void ScanReader::queueStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  if (ring_.dropped() > 0)
+    stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Scans dropped from the acquisition queue");
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "No scans dropped");
+  stat.add("Queue capacity", (int)ring_.capacity());
+  stat.add("Queued scans", (int)ring_.size());
+  stat.add("Overflow policy", ring_.policy() == DROP_OLDEST ? "drop_oldest" : "drop_newest");
+  stat.add("Scans read", ring_.pushed());
+  stat.add("Scans dropped", ring_.dropped());
+}
+
+void ScanReader::run()
+{
+  try
+  {
+    if (setup_)
+      setup_();
+    // Hold on to the scan across reads that come back empty, and take
+    // back whichever one the ring had to give up to queue it.
+    PlsScan *scan = NULL;
+    while (running_)
+    {
+      if (!scan)
+        scan = pool_.acquire();
+      if (!read_(*scan))
+        continue;
+      PlsScan *lost = NULL;
+      ring_.push(scan, lost);
+      signal();
+      scan = lost;
+      if (scan)
+        scan->clear();
+    }
+  }
+  catch (...)
+  {
+    ROS_ERROR("Unknown error in the scan acquisition thread.");
+    failed_ = true;
+    signal();
+  }
+}
+
+// Figure out the time that the scan started from when we finished
+// receiving it.
+static ros::Time scan_start_time(const ros::Time &end_of_scan, uint32_t n_range_values,
+                                 double scan_time, ScanTimestamper *timestamper)
+{
+  if (timestamper)
+    return ros::Time(timestamper->stamp(end_of_scan.toSec(), n_range_values));
+  // Without the model we assume that the mirror is at 180 degrees now,
+  // or half a scan time. In other words, we assume a zero transfer time
+  // of the data.
+  return end_of_scan - ros::Duration(scan_time / 2.0);
+}
+
+static void timestamp_status(diagnostic_updater::DiagnosticStatusWrapper &stat, ScanTimestamper *timestamper)
+{
+  stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Filtering scan timestamps");
+  stat.add("Frame period (s)", timestamper->period());
+  stat.add("Mean read delay (s)", timestamper->meanDelay());
+  stat.add("Filter resets", timestamper->resets());
+}
+
+static void add_histogram(diagnostic_updater::DiagnosticStatusWrapper &stat, const std::string &name,
+                          const LatencyHistogram &histogram)
+{
+  stat.add(name + " p50 (us)", histogram.valueAtPercentile(50) / 1000.0);
+  stat.add(name + " p99 (us)", histogram.valueAtPercentile(99) / 1000.0);
+  stat.add(name + " p99.9 (us)", histogram.valueAtPercentile(99.9) / 1000.0);
+  stat.add(name + " max (us)", histogram.max() / 1000.0);
+}
+
+// Where ROS keeps its own state: $ROS_HOME, or ~/.ros.
+static std::string default_baud_cache_dir()
+{
+  const char *ros_home = getenv("ROS_HOME");
+  if (ros_home)
+    return ros_home;
+  const char *home = getenv("HOME");
+  if (home)
+    return std::string(home) + "/.ros";
+  return "";
+}
+
+// An XmlRpc int or double as a double; roscpp won't do this for list items.
+static bool xml_number(XmlRpc::XmlRpcValue &value, double &number)
+{
+  if (value.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    number = static_cast<double>(value);
+  else if (value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+    number = static_cast<int>(value);
+  else
+    return false;
+  return true;
+}
+
+// ~protective_field/polygon: [[x, y], ...], and sectors:
+// [{angle_min: deg, angle_max: deg, range: m}, ...]
+static void load_protective_field(const ParamSnapshot &params, PlsDeviceConfig &config)
+{
+  config.field_polygon.clear();
+  config.field_sectors.clear();
+  XmlRpc::XmlRpcValue polygon;
+  if (params.getParam("polygon", polygon)) {
+    bool ok = polygon.getType() == XmlRpc::XmlRpcValue::TypeArray && polygon.size() >= 3;
+    for (int i = 0; ok && i < polygon.size(); i++) {
+      double x, y;
+      ok = polygon[i].getType() == XmlRpc::XmlRpcValue::TypeArray && polygon[i].size() == 2 &&
+           xml_number(polygon[i][0], x) && xml_number(polygon[i][1], y);
+      config.field_polygon.push_back(x);
+      config.field_polygon.push_back(y);
+    }
+    if (!ok) {
+      ROS_WARN("~protective_field/polygon should be a list of at least 3 [x, y] points; ignoring it.");
+      config.field_polygon.clear();
+    }
+  }
+  XmlRpc::XmlRpcValue sectors;
+  if (params.getParam("sectors", sectors)) {
+    if (sectors.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+      ROS_WARN("~protective_field/sectors should be a list; ignoring it.");
+    }
+    else {
+      for (int i = 0; i < sectors.size(); i++) {
+        XmlRpc::XmlRpcValue &sector = sectors[i];
+        double angle_min, angle_max, range;
+        if (sector.getType() != XmlRpc::XmlRpcValue::TypeStruct || !sector.hasMember("angle_min") ||
+            !sector.hasMember("angle_max") || !sector.hasMember("range") ||
+            !xml_number(sector["angle_min"], angle_min) || !xml_number(sector["angle_max"], angle_max) ||
+            !xml_number(sector["range"], range)) {
+          ROS_WARN("Skipping ~protective_field/sectors entry %d: it needs angle_min, angle_max and range.", i);
+          continue;
+        }
+        config.field_sectors.push_back(angle_min);
+        config.field_sectors.push_back(angle_max);
+        config.field_sectors.push_back(range);
+      }
+    }
+  }
+  params.param("min_readings", config.field_min_readings, 1);
+  if (config.field_min_readings < 1)
+    config.field_min_readings = 1;
+  params.param<std::string>("topic", config.field_topic,
+                            config.name.empty() ? "protective_field" : config.name + "/protective_field");
+  params.param<std::string>("udp", config.field_udp, "");
+  params.param<std::string>("gpio_value_file", config.field_gpio_file, "");
+  params.param("trip_on_loss", config.field_trip_on_loss, true);
+}
+
+void PlsDeviceConfig::load(const ParamSnapshot &params)
+{
+  params.param("port", port, std::string("/dev/sickpls"));
+  params.param("baud", baud, 38400);
+  params.param("inverted", inverted, false);
+  params.param<std::string>("frame_id", frame_id, name.empty() ? "laser" : name);
+  params.param<std::string>("topic", topic, name.empty() ? "scan" : name + "/scan");
+
+  // Read the laser on its own thread and hand scans over through a queue
+  params.param("acquisition_thread", acquisition_thread, false);
+  params.param("scan_queue_size", scan_queue_size, 8);
+  std::string overflow_policy_name;
+  params.param<std::string>("queue_overflow_policy", overflow_policy_name, "drop_oldest");
+  overflow_policy = DROP_OLDEST;
+  if (overflow_policy_name == "drop_newest")
+    overflow_policy = DROP_NEWEST;
+  else if (overflow_policy_name != "drop_oldest")
+    ROS_WARN("Unknown queue_overflow_policy \"%s\", using drop_oldest.", overflow_policy_name.c_str());
+  if (scan_queue_size < 1)
+    scan_queue_size = 1;
+
+  // Model the serial transfer time and filter out read jitter when stamping
+  params.param("filter_timestamps", filter_timestamps, false);
+
+  // Publish from a set of reused messages instead of building one per scan
+  params.param("message_pool_size", message_pool_size, 0);
+
+  // Time every stage of the loop, and optionally log every scan's timings
+  params.param("instrumentation", instrumentation, true);
+  params.param<std::string>("trace_file", trace_file, "");
+
+  // Reconnect in place when the laser stops answering, remembering its
+  // baud rate across connections so it can be found again quickly
+  params.param("reconnect", reconnect, true);
+  params.param("power_on_delay", power_on_delay, 0);
+  params.param<std::string>("baud_cache_dir", baud_cache_dir, default_baud_cache_dir());
+
+  // Have the laser send scans unasked and parse them ourselves rather than
+  // polling through sicktoolbox; what it takes to keep up at 500 kbaud
+  params.param("streaming", streaming, false);
+
+  // Filters to run on each scan before it's published, in order
+  filters.clear();
+  XmlRpc::XmlRpcValue filters_param;
+  if (params.getParam("filters", filters_param)) {
+    if (filters_param.getType() == XmlRpc::XmlRpcValue::TypeArray) {
+      for (int i = 0; i < filters_param.size(); i++)
+        if (filters_param[i].getType() == XmlRpc::XmlRpcValue::TypeString)
+          filters.push_back(static_cast<std::string>(filters_param[i]));
+    }
+    else {
+      ROS_WARN("~filters should be a list of filter names; not filtering.");
+    }
+  }
+  params.param("temporal_median_window", temporal_median_window, 5);
+  params.param("spatial_median_window", spatial_median_window, 3);
+  params.param("shadow_min_angle", shadow_min_angle, 10.0);
+  params.param("shadow_max_angle", shadow_max_angle, 170.0);
+  params.param("shadow_window", shadow_window, 1);
+
+  // Merge this many consecutive scans, each offset by a fraction of a
+  // reading's angle, into one denser scan on the scan topic
+  params.param("interleave", interleave, 1);
+  if (interleave < 1 || interleave > 4) {
+    ROS_WARN("~interleave must be 1 to 4; not interleaving.");
+    interleave = 1;
+  }
+
+  // Also publish scans delta-coded against the one before, for slow links
+  params.param("publish_compressed", publish_compressed, false);
+  params.param<std::string>("compressed_topic", compressed_topic, topic + "_compressed");
+  params.param("keyframe_interval", keyframe_interval, 75);
+  params.param("compression_deadband", compression_deadband, 0);
+  if (keyframe_interval < 1)
+    keyframe_interval = 1;
+  if (compression_deadband < 0)
+    compression_deadband = 0;
+
+  // Publish a point cloud as well as, or instead of, the LaserScan
+  params.param("publish_scan", publish_scan, true);
+  params.param("publish_cloud", publish_cloud, false);
+  params.param<std::string>("cloud_topic", cloud_topic, name.empty() ? "cloud" : name + "/cloud");
+  params.param("dense_cloud", dense_cloud, true);
+  // and each reading's status bits, as the laser read them before ~filters
+  params.param("publish_status", publish_status, false);
+  params.param<std::string>("status_topic", status_topic, name.empty() ? "scan_status" : name + "/scan_status");
+
+  // Also hand scans to consumers on this host through shared memory
+  params.param<std::string>("shm_name", shm_name, "");
+  params.param("shm_slots", shm_slots, 16);
+
+  // Pin the threads that read the laser to CPUs and run them SCHED_FIFO,
+  // and keep the driver's memory resident; for when the planners would
+  // otherwise make us miss frames
+  std::string cpus;
+  params.param<std::string>("acquisition_cpus", cpus, "");
+  if (!cpus.empty() && !parse_cpu_list(cpus, acquisition_cpus))
+    ROS_WARN("Ignoring ~acquisition_cpus \"%s\": expected a CPU list like 2 or 0,2-3.", cpus.c_str());
+  params.param("acquisition_priority", acquisition_priority, 0);
+  params.param<std::string>("monitor_cpus", cpus, "");
+  if (!cpus.empty() && !parse_cpu_list(cpus, monitor_cpus))
+    ROS_WARN("Ignoring ~monitor_cpus \"%s\": expected a CPU list like 2 or 0,2-3.", cpus.c_str());
+  params.param("monitor_priority", monitor_priority, 0);
+  params.param("lock_memory", lock_memory, false);
+
+  // Check every scan against a protective field as soon as it's read and
+  // report when something comes into it, ahead of the scan itself
+  load_protective_field(params.child("protective_field"), *this);
+
+  // Which laser this is in the driver's UDP datagrams (~udp_destination)
+  params.param("udp_sensor_id", udp_sensor_id, 0);
+
+  // Call the laser stalled after this many frame periods without a scan,
+  // and (when streaming) reconnect; 0 leaves it to the read timeouts
+  params.param("watchdog_periods", watchdog_periods, 3);
+  if (watchdog_periods < 0)
+    watchdog_periods = 0;
+
+  // Keep the newest history_size scans, as published, for consumers that
+  // join late or look scans up by time through the history service
+  params.param("history_size", history_size, 0);
+  params.param<std::string>("history_service", history_service,
+                            name.empty() ? "scan_history" : name + "/scan_history");
+  if (history_size < 0)
+    history_size = 0;
+  if (history_size > 0 && interleave > 1) {
+    // The scans it would keep are the partial ones nobody else sees
+    ROS_WARN("~history_size doesn't work with ~interleave; keeping no history.");
+    history_size = 0;
+  }
+  if ((!acquisition_cpus.empty() || acquisition_priority > 0) && !acquisition_thread)
+    ROS_WARN("~acquisition_cpus and ~acquisition_priority only apply with ~acquisition_thread.");
+
+  // Extra topics that publish every Nth scan at every Mth reading, e.g.
+  //   decimated_topics: [{topic: scan_ui, every: 15, bins: 4, mode: min}]
+  decimated_topics.clear();
+  XmlRpc::XmlRpcValue decimated_param;
+  if (params.getParam("decimated_topics", decimated_param)) {
+    if (decimated_param.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+      ROS_WARN("~decimated_topics should be a list; not publishing any.");
+    }
+    else {
+      for (int i = 0; i < decimated_param.size(); i++) {
+        XmlRpc::XmlRpcValue &entry = decimated_param[i];
+        if (entry.getType() != XmlRpc::XmlRpcValue::TypeStruct || !entry.hasMember("topic") ||
+            entry["topic"].getType() != XmlRpc::XmlRpcValue::TypeString) {
+          ROS_WARN("Skipping ~decimated_topics entry %d: it needs at least a topic.", i);
+          continue;
+        }
+        DecimatedTopicConfig decimated;
+        decimated.topic = static_cast<std::string>(entry["topic"]);
+        decimated.every = 1;
+        decimated.bins = 1;
+        decimated.min_pooling = false;
+        if (entry.hasMember("every") && entry["every"].getType() == XmlRpc::XmlRpcValue::TypeInt)
+          decimated.every = static_cast<int>(entry["every"]);
+        if (entry.hasMember("bins") && entry["bins"].getType() == XmlRpc::XmlRpcValue::TypeInt)
+          decimated.bins = static_cast<int>(entry["bins"]);
+        if (entry.hasMember("mode") && entry["mode"].getType() == XmlRpc::XmlRpcValue::TypeString) {
+          std::string mode = static_cast<std::string>(entry["mode"]);
+          if (mode == "min")
+            decimated.min_pooling = true;
+          else if (mode != "sample")
+            ROS_WARN("Unknown decimation mode \"%s\" for %s, using sample.", mode.c_str(),
+                     decimated.topic.c_str());
+        }
+        decimated_topics.push_back(decimated);
+      }
+    }
+  }
+}
+
+PlsDevice::PlsDevice(const PlsDeviceConfig &config, const ParamSnapshot &params)
+  : config_(config), baud_cache_(config.baud_cache_dir, config.port),
+    scan_pool_(std::max(config.message_pool_size, 1)), timestamper_(1.0 / 75, config.baud),
+    scale_(0), scan_time_(0), angle_min_(0), angle_max_(0), direct_scans_(1),
+    interleaved_pool_(std::max(config.message_pool_size, 2)), udp_(NULL), udp_sequence_(0), field_state_(-1), field_readings_(0),
+    field_trips_(0), history_converter_(NULL), history_queries_(0), keyframe_requested_(false), compressed_keyframes_(0), compressed_deltas_(0),
+    compressed_unchanged_(0), compressed_bytes_(0), uncompressed_bytes_(0), connected_(false),
+    reconnected_(false), last_attempt_ns_(0), used_cached_baud_(false), reconnects_(0),
+    memory_locked_(false), watchdog_deadline_ns_(0), last_scan_ns_(0), stalled_(false), stalls_(0),
+    stream_timeout_(1.0), last_read_end_ns_(0)
+{
+  direct_scan_ = direct_scans_.acquire();
+  diagnostic_params_.load(params, 75.0 / config_.interleave);
+  // Several lasers reporting the same hardware id can't be told apart
+  if (!config_.name.empty() && !params.hasParam("hardware_id"))
+    diagnostic_params_.hardware_id += " " + config_.name;
+}
+
+PlsDevice::~PlsDevice()
+{
+  stop();
+  stopWatchdog();
+}
+
+void PlsDevice::advertise(ros::NodeHandle &nh)
+{
+  updater_.setHardwareID(diagnostic_params_.hardware_id);
+  scan_pub_.reset(new diagnostic_updater::DiagnosedPublisher<sensor_msgs::LaserScan>(
+                    nh.advertise<sensor_msgs::LaserScan>(config_.topic, 10), updater_,
+                    diagnostic_params_.frequencyStatusParam(),
+                    diagnostic_params_.timeStampStatusParam()));
+  for (size_t i = 0; i < config_.decimated_topics.size(); i++)
+    decimated_.push_back(boost::shared_ptr<DecimatedScanPublisher>(
+                           new DecimatedScanPublisher(nh, config_.decimated_topics[i])));
+  if (config_.publish_cloud)
+    cloud_.reset(new CloudPublisher(nh, config_.cloud_topic, config_.dense_cloud));
+  if (config_.publish_status)
+    status_.reset(new StatusPublisher(nh, config_.status_topic));
+  if (config_.publish_compressed) {
+    compressed_pub_ = nh.advertise<CompressedScan>(
+      config_.compressed_topic, 10, boost::bind(&PlsDevice::compressedSubscriberConnected, this, _1));
+    encoder_.reset(new ScanDeltaEncoder(config_.keyframe_interval, config_.compression_deadband));
+    compressed_msg_.num_ranges = 0; // filled in from the first scan
+  }
+  if (!config_.field_polygon.empty() || !config_.field_sectors.empty())
+    field_pub_ = nh.advertise<std_msgs::Bool>(config_.field_topic, 1, true);
+  if (config_.watchdog_periods > 0)
+    diagnostics_pub_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+  if (config_.history_size > 0) {
+    history_.reset(new ScanHistory(config_.history_size));
+    history_srv_ = nh.advertiseService(config_.history_service, &PlsDevice::historyService, this);
+  }
+}
+
+// Held while looking for the thread a new connection starts, so that
+// another laser connecting at the same time can't start one too.
+static boost::mutex monitor_thread_mutex;
+
+void PlsDevice::connect()
+{
+  if (config_.streaming || (config_.monitor_cpus.empty() && config_.monitor_priority <= 0)) {
+    connectLaser();
+    return;
+  }
+
+  // sicktoolbox doesn't say which thread watches the port, but it's started
+  // by Initialize, so it's the one that wasn't there before.
+  boost::mutex::scoped_lock spawn_lock(monitor_thread_mutex);
+  std::vector<pid_t> before = process_thread_ids();
+  connectLaser();
+  std::vector<pid_t> after = process_thread_ids();
+  std::vector<pid_t> started;
+  std::set_difference(after.begin(), after.end(), before.begin(), before.end(),
+                      std::back_inserter(started));
+
+  ThreadTuning tuning;
+  if (started.size() == 1) {
+    tuning = tune_thread(started[0], config_.monitor_cpus, config_.monitor_priority);
+  }
+  else {
+    tuning.cpus = config_.monitor_cpus;
+    tuning.priority = config_.monitor_priority;
+    tuning.error = "couldn't tell which thread is sicktoolbox's";
+  }
+  if (!tuning.granted())
+    ROS_WARN("Monitor thread for %s: %s", config_.port.c_str(), tuning.describe().c_str());
+  boost::mutex::scoped_lock lock(status_mutex_);
+  monitor_tuning_ = tuning;
+}
+
+void PlsDevice::tuneAcquisitionThread()
+{
+  if (config_.lock_memory)
+    prefault_stack(256 * 1024);
+  if (config_.acquisition_cpus.empty() && config_.acquisition_priority <= 0)
+    return;
+  ThreadTuning tuning = tune_thread(current_thread_id(), config_.acquisition_cpus,
+                                    config_.acquisition_priority);
+  if (!tuning.granted())
+    ROS_WARN("Acquisition thread for %s: %s", config_.port.c_str(), tuning.describe().c_str());
+  boost::mutex::scoped_lock lock(status_mutex_);
+  acquisition_tuning_ = tuning;
+}
+
+void PlsDevice::connectLaser()
+{
+  SickPLS::sick_pls_baud_t desired_baud = SickPLS::IntToSickBaud(config_.baud);
+  last_attempt_ns_ = monotonic_ns();
+
+  if (config_.streaming) {
+    uint32_t cached_baud = baud_cache_.load();
+    if (!stream_)
+      stream_.reset(new PlsStream);
+    if (!stream_->open(config_.port, config_.baud, cached_baud))
+      throw SickIOException(stream_->error());
+    {
+      boost::mutex::scoped_lock lock(status_mutex_);
+      used_cached_baud_ = cached_baud != 0;
+    }
+    if (!baud_cache_.path().empty() && !baud_cache_.store(config_.baud))
+      ROS_WARN_ONCE("Couldn't write the baud rate cache %s", baud_cache_.path().c_str());
+    connected_ = true;
+    return;
+  }
+
+  // If we know what rate the laser was left at, switch it back to 9600
+  // ourselves so that sicktoolbox's probe finds it on its first try, and
+  // skip the power-on delay: the laser was on a moment ago.
+  uint32_t cached_baud = baud_cache_.load();
+  if (cached_baud == 9600 || (cached_baud && pls_reset_session_baud(config_.port, cached_baud, 0.5))) {
+    try {
+      sick_pls_.reset(new SickPLS(config_.port));
+      sick_pls_->Initialize(desired_baud);
+      boost::mutex::scoped_lock lock(status_mutex_);
+      used_cached_baud_ = true;
+    }
+    catch (SickException &e) {
+      ROS_WARN("Couldn't connect at the cached baud rate (%s), probing.", e.what());
+      cached_baud = 0;
+    }
+  }
+  else {
+    cached_baud = 0;
+  }
+
+  if (!cached_baud) {
+    sick_pls_.reset(new SickPLS(config_.port));
+    sick_pls_->Initialize(desired_baud, config_.power_on_delay);
+    boost::mutex::scoped_lock lock(status_mutex_);
+    used_cached_baud_ = false;
+  }
+
+  if (!baud_cache_.path().empty() && !baud_cache_.store(config_.baud))
+    ROS_WARN_ONCE("Couldn't write the baud rate cache %s", baud_cache_.path().c_str());
+  connected_ = true;
+}
+
+bool PlsDevice::reconnect()
+{
+  // Don't hammer a laser that's still missing.
+  uint64_t since = monotonic_ns() - last_attempt_ns_;
+  if (since < 1000000000ULL)
+    usleep((1000000000ULL - since) / 1000);
+
+  try {
+    if (stream_)
+      stream_->close();
+    if (sick_pls_)
+      sick_pls_->Uninitialize();
+  }
+  catch (...) {
+    // Expected when the port has gone away.
+  }
+
+  try {
+    connect();
+  }
+  catch (SickException &e) {
+    boost::mutex::scoped_lock lock(status_mutex_);
+    last_error_ = e.what();
+    return false;
+  }
+  reconnected_ = true;
+  boost::mutex::scoped_lock lock(status_mutex_);
+  reconnects_++;
+  ROS_INFO("Reconnected to the laser on %s.", config_.port.c_str());
+  return true;
+}
+
+void PlsDevice::lost(const char *what)
+{
+  ROS_WARN("Lost the laser on %s (%s), reconnecting.", config_.port.c_str(), what);
+  connected_ = false;
+  // Blind is as good as blocked
+  if (!field_.empty() && config_.field_trip_on_loss)
+    setFieldState(true, 0, ros::Time::now().toNSec());
+  boost::mutex::scoped_lock lock(status_mutex_);
+  last_error_ = what;
+}
+
+bool PlsDevice::readScan(PlsScan &scan)
+{
+  if (!connected_ && !reconnect())
+    return false;
+  try {
+    scan.read_begin_ns = monotonic_ns();
+    if (stream_) {
+      int got = stream_->next(scan, stream_timeout_);
+      if (got == 0) {
+        char what[64];
+        snprintf(what, sizeof(what), "no scan from the PLS for %.0f ms", stream_timeout_ * 1000);
+        throw SickTimeoutException(what);
+      }
+      if (got < 0)
+        throw SickIOException(stream_->error());
+    }
+    else {
+      sick_pls_->GetSickScan(scan.ranges, scan.size);
+      scan.deriveStatus();
+    }
+    scan.host_stamp_ns = ros::Time::now().toNSec();
+    scan.read_end_ns = monotonic_ns();
+    last_scan_ns_ = scan.read_end_ns;
+    if (!field_.empty())
+      checkField(scan);
+    return true;
+  }
+  catch (SickTimeoutException &e) {
+    if (!config_.reconnect)
+      throw;
+    lost(e.what());
+  }
+  catch (SickIOException &e) {
+    if (!config_.reconnect)
+      throw;
+    lost(e.what());
+  }
+  return false;
+}
+
+bool PlsDevice::open()
+{
+  connect();
+
+  // There's no asking a streaming laser; but then the PLS only does cm.
+  SickPLS::sick_pls_measuring_units_t actual_units =
+    stream_ ? SickPLS::SICK_MEASURING_UNITS_CM : sick_pls_->GetSickMeasuringUnits();
+
+  if (actual_units == SickPLS::SICK_MEASURING_UNITS_CM) {
+    scale_ = 0.01;
+  }
+  else {
+    ROS_ERROR("Invalid measuring unit.");
+    return false;
+  }
+
+  // The scan time is always 1/75 because that's how long it takes
+  // for the mirror to rotate. If we have a higher resolution, the
+  // SICKs interleave the readings, so the net result is we just
+  // shift the measurements.
+
+  //TODO work out what this should be for the PLS
+  scan_time_ = 1.0 / 75;
+
+  // Interleaved scans (~interleave) cover the same field of view, only
+  // more densely once merged
+  angle_min_ = -M_PI/2;
+  angle_max_ = M_PI/2;
+  return true;
+}
+
+bool PlsDevice::initialize(ros::NodeHandle &nh)
+{
+  advertise(nh);
+  if (!open())
+    return false;
+  setup();
+  return true;
+}
+
+void PlsDevice::setup()
+{
+  scan_pool_.configure(scale_, scan_time_, config_.inverted, angle_min_, angle_max_, config_.frame_id);
+  for (size_t i = 0; i < decimated_.size(); i++)
+    decimated_[i]->configure(scale_, scan_time_, config_.inverted, angle_min_, angle_max_, config_.frame_id);
+  if (cloud_)
+    cloud_->configure(scale_, scan_time_, config_.inverted, angle_min_, angle_max_, config_.frame_id);
+  if (status_)
+    status_->configure(config_.frame_id);
+  history_converter_ = select_scan_converter(scale_);
+  if (!config_.shm_name.empty()) {
+    if (shm_.open(config_.shm_name, config_.port, std::max(config_.shm_slots, 2))) {
+      sensor_msgs::LaserScan geometry;
+      fill_scan_metadata(geometry, SickPLS::SICK_MAX_NUM_MEASUREMENTS, scale_, scan_time_, config_.inverted,
+                         angle_min_, angle_max_, config_.frame_id);
+      shm_.setGeometry(scale_, geometry.angle_min, geometry.angle_increment, scan_time_, config_.frame_id);
+    }
+    else {
+      ROS_WARN("Not sharing scans in memory: %s", shm_.error().c_str());
+    }
+  }
+  buildFilters();
+  if (field_pub_) {
+    if (!config_.field_polygon.empty())
+      field_.setPolygon(config_.field_polygon);
+    for (size_t i = 0; i + 2 < config_.field_sectors.size(); i += 3)
+      field_.addSector(config_.field_sectors[i] * M_PI / 180, config_.field_sectors[i + 1] * M_PI / 180,
+                       config_.field_sectors[i + 2]);
+    // The same angles the LaserScan has, inverted or not
+    field_.configure(SickPLS::SICK_MAX_NUM_MEASUREMENTS, config_.inverted ? angle_max_ : angle_min_,
+                     config_.inverted ? angle_min_ : angle_max_, scale_);
+    if (!field_signal_.open(config_.field_udp, config_.field_gpio_file))
+      ROS_WARN("Protective field: %s", field_signal_.error().c_str());
+  }
+  if (config_.interleave > 1) {
+    interleaver_.reset(new ScanInterleaver(config_.interleave, SickPLS::SICK_MAX_NUM_MEASUREMENTS));
+    // A set is only a set if no frame went missing in the middle of it
+    interleaver_->setMaxGap((uint64_t)(1.5e9 * ScanTimestamper::framePeriod(
+                                         scan_time_, config_.baud, SickPLS::SICK_MAX_NUM_MEASUREMENTS)));
+    interleaved_pool_.configure(scale_, scan_time_ * config_.interleave, config_.inverted, angle_min_,
+                                angle_max_, config_.frame_id);
+  }
+
+  std::string prefix = config_.name.empty() ? "" : config_.name + " ";
+  updater_.add(prefix + "Connection", this, &PlsDevice::connectionStatus);
+  if (stream_)
+    updater_.add(prefix + "Stream", this, &PlsDevice::streamStatus);
+  if (config_.filter_timestamps)
+    updater_.add(prefix + "Timestamps", boost::bind(&timestamp_status, _1, &timestamper_));
+  if (config_.acquisition_thread) {
+    reader_.reset(new ScanReader(boost::bind(&PlsDevice::readScan, this, _1),
+                                 config_.scan_queue_size, config_.overflow_policy));
+    updater_.add(prefix + "Scan queue", reader_.get(), &ScanReader::queueStatus);
+    reader_->setThreadSetup(boost::bind(&PlsDevice::tuneAcquisitionThread, this));
+  }
+  if (config_.lock_memory || !config_.monitor_cpus.empty() || config_.monitor_priority > 0 ||
+      (reader_ && (!config_.acquisition_cpus.empty() || config_.acquisition_priority > 0)))
+    updater_.add(prefix + "Real-time", this, &PlsDevice::realtimeStatus);
+  if (encoder_)
+    updater_.add(prefix + "Compression", this, &PlsDevice::compressionStatus);
+  if (interleaver_)
+    updater_.add(prefix + "Interleave", this, &PlsDevice::interleaveStatus);
+  if (!field_.empty())
+    updater_.add(prefix + "Protective field", this, &PlsDevice::fieldStatus);
+  if (udp_)
+    updater_.add(prefix + "UDP output", this, &PlsDevice::udpStatus);
+  if (history_)
+    updater_.add(prefix + "Scan history", this, &PlsDevice::historyStatus);
+  if (config_.watchdog_periods > 0) {
+    // A few frames at the rate this link carries them, but not so tight
+    // that scheduling jitter trips it
+    watchdog_deadline_ns_ = std::max((uint64_t)(config_.watchdog_periods * 1e9 *
+                                                ScanTimestamper::framePeriod(scan_time_, config_.baud,
+                                                                             SickPLS::SICK_MAX_NUM_MEASUREMENTS)),
+                                     (uint64_t)50000000);
+    // sicktoolbox's reads time out on their own schedule, but a stream's
+    // can go as soon as the watchdog would
+    stream_timeout_ = watchdog_deadline_ns_ * 1e-9;
+    updater_.add(prefix + "Watchdog", this, &PlsDevice::watchdogStatus);
+    last_scan_ns_ = monotonic_ns();
+    watchdog_ = boost::thread(boost::bind(&PlsDevice::watch, this));
+  }
+  if (config_.instrumentation)
+    updater_.add(prefix + "Loop timing", this, &PlsDevice::loopTimingStatus);
+  if (!config_.trace_file.empty() && !trace_.open(config_.trace_file, config_.port))
+    ROS_WARN("Not writing a timing trace: %s", trace_.error().c_str());
+
+  // Last, once everything the loop uses has been allocated; MCL_FUTURE
+  // takes care of what comes after.
+  if (config_.lock_memory) {
+    std::string error;
+    bool locked = sicktoolbox_pls_wrapper::lock_memory(error);
+    if (!locked)
+      ROS_WARN("Couldn't lock the driver's memory: %s", error.c_str());
+    else
+      prefault_stack(256 * 1024);
+    boost::mutex::scoped_lock lock(status_mutex_);
+    memory_locked_ = locked;
+    memory_error_ = error;
+  }
+}
+
+void PlsDevice::uninitialize()
+{
+  // Going quiet is the point now
+  stopWatchdog();
+  shm_.close();
+  if (trace_.isOpen() && !trace_.close())
+    ROS_WARN("Error writing the timing trace: %s", trace_.error().c_str());
+  if (!connected_)
+    return;
+  if (stream_)
+    stream_->close();
+  else
+    sick_pls_->Uninitialize();
+  // which leaves the laser at 9600
+  baud_cache_.store(9600);
+}
+
+void PlsDevice::start()
+{
+  if (reader_)
+    reader_->start();
+}
+
+void PlsDevice::stop()
+{
+  if (reader_)
+    reader_->stop();
+}
+
+void PlsDevice::stopWatchdog()
+{
+  if (watchdog_.joinable()) {
+    watchdog_.interrupt();
+    watchdog_.join();
+  }
+}
+
+void PlsDevice::watch()
+{
+  try {
+    for (;;) {
+      boost::this_thread::sleep(boost::posix_time::microseconds(
+                                  std::max(watchdog_deadline_ns_ / 4000, (uint64_t)1000)));
+      uint64_t last = last_scan_ns_;
+      uint64_t now = monotonic_ns();
+      uint64_t silent = now > last ? now - last : 0;
+      if (!stalled_ && silent > watchdog_deadline_ns_) {
+        stalled_ = true;
+        stalls_++;
+        ROS_WARN("No scan from the laser on %s for %.0f ms.", config_.port.c_str(), silent * 1e-6);
+        publishWatchdog(silent);
+      }
+      else if (stalled_ && silent <= watchdog_deadline_ns_) {
+        stalled_ = false;
+        publishWatchdog(silent);
+      }
+    }
+  }
+  catch (boost::thread_interrupted &) {
+  }
+}
+
+// The same status the updater reports as "Watchdog", sent now.
+void PlsDevice::publishWatchdog(uint64_t silent_ns)
+{
+  diagnostic_updater::DiagnosticStatusWrapper stat;
+  watchdogStatus(stat);
+  std::string node_name = ros::this_node::getName();
+  std::string prefix = config_.name.empty() ? "" : config_.name + " ";
+  stat.name = (node_name.empty() ? node_name : node_name.substr(1)) + ": " + prefix + "Watchdog";
+  stat.hardware_id = diagnostic_params_.hardware_id;
+  stat.add("Time since last scan (ms)", silent_ns * 1e-6);
+
+  diagnostic_msgs::DiagnosticArrayPtr msg(new diagnostic_msgs::DiagnosticArray);
+  msg->header.stamp = ros::Time::now();
+  msg->status.push_back(stat);
+  diagnostics_pub_.publish(msg);
+}
+
+void PlsDevice::buildFilters()
+{
+  const uint32_t max_values = SickPLS::SICK_MAX_NUM_MEASUREMENTS;
+  double angle_increment = (angle_max_ - angle_min_) / (max_values - 1);
+  for (size_t i = 0; i < config_.filters.size(); i++) {
+    const std::string &name = config_.filters[i];
+    if (name == "temporal_median")
+      filters_.add(boost::shared_ptr<ScanFilter>(
+                     new TemporalMedianFilter(std::max(config_.temporal_median_window, 1), max_values)));
+    else if (name == "spatial_median")
+      filters_.add(boost::shared_ptr<ScanFilter>(
+                     new SpatialMedianFilter(std::max(config_.spatial_median_window, 1), max_values)));
+    else if (name == "shadow")
+      filters_.add(boost::shared_ptr<ScanFilter>(
+                     new ShadowFilter(config_.shadow_min_angle * M_PI / 180, config_.shadow_max_angle * M_PI / 180,
+                                      std::max(config_.shadow_window, 1), angle_increment, max_values)));
+    else
+      ROS_WARN("Unknown scan filter \"%s\"; expected temporal_median, spatial_median or shadow.", name.c_str());
+  }
+}
+
+void PlsDevice::checkField(const PlsScan &scan)
+{
+  uint32_t readings = field_.check(scan.ranges, scan.size);
+  setFieldState(readings >= (uint32_t)config_.field_min_readings, readings, scan.host_stamp_ns);
+}
+
+// Only changes go out: the topic is latched and the hooks are edge-triggered.
+void PlsDevice::setFieldState(bool intruded, uint32_t readings, uint64_t stamp_ns)
+{
+  field_readings_ = readings;
+  if (field_state_ == (int)intruded)
+    return;
+  field_state_ = intruded;
+  if (intruded)
+    field_trips_++;
+  if (field_signal_.isOpen())
+    field_signal_.signal(intruded, stamp_ns, readings);
+  std_msgs::BoolPtr msg(new std_msgs::Bool);
+  msg->data = intruded;
+  field_pub_.publish(msg);
+}
+
+// Sent with the other lasers' on the driver's next flush.
+void PlsDevice::queueUdp(const PlsScan &scan, const ros::Time &start)
+{
+  PlsUdpHeader header;
+  header.sequence = udp_sequence_++;
+  header.sensor = config_.udp_sensor_id;
+  header.host_stamp_ns = start.toNSec();
+  header.device_stamp_ns = scan.has(PlsScan::DEVICE_STAMP) ? scan.device_stamp_ns : 0;
+  header.scale = scale_;
+  // The same angles the LaserScan has, inverted or not
+  float first = config_.inverted ? angle_max_ : angle_min_;
+  float last = config_.inverted ? angle_min_ : angle_max_;
+  header.angle_min = first;
+  header.angle_increment = scan.size > 1 ? (last - first) / (scan.size - 1) : 0;
+  header.scan_time = scan_time_;
+  udp_->add(header, scan.ranges, scan.size);
+}
+
+void PlsDevice::publish(PlsScan &scan)
+{
+  // Frames from a new connection aren't on the old connection's grid, and
+  // the old connection's scans shouldn't bleed into the new one's.
+  if (reconnected_) {
+    reconnected_ = false;
+    timestamper_.reset();
+    filters_.reset();
+    if (interleaver_)
+      interleaver_->reset();
+  }
+  uint64_t filter_ns = 0;
+  if (!filters_.empty()) {
+    uint64_t t0 = monotonic_ns();
+    filters_.apply(scan);
+    filter_ns = monotonic_ns() - t0;
+  }
+  // Taken from when the scan was read rather than when we got to it.
+  ros::Time end_of_scan;
+  end_of_scan.fromNSec(scan.host_stamp_ns);
+  ros::Time start = scan_start_time(end_of_scan, scan.size, scan_time_,
+                                    config_.filter_timestamps ? &timestamper_ : NULL);
+  // Local consumers first; they're the ones in a hurry.
+  if (shm_.isOpen())
+    shm_.write(start.toNSec(), scan.ranges, scan.size);
+  if (udp_)
+    queueUdp(scan, start);
+  bool timed = config_.instrumentation || trace_.isOpen();
+  PublishTiming timing;
+  if (interleaver_) {
+    timing.convert_ns = 0;
+    timing.publish_ns = 0;
+    if (interleaver_->add(scan.ranges, scan.size, start.toNSec())) {
+      ros::Time merged_start;
+      merged_start.fromNSec(interleaver_->stamp());
+      if (config_.publish_scan)
+        publish_scan(scan_pub_.get(), interleaver_->values(), interleaver_->size(),
+                     scale_, merged_start, scan_time_ * config_.interleave, config_.inverted, angle_min_,
+                     angle_max_, config_.frame_id, &interleaved_pool_, timed ? &timing : NULL);
+      else
+        scan_pub_->tick(merged_start);
+    }
+  }
+  else if (config_.publish_scan) {
+    publish_scan(scan_pub_.get(), scan.ranges, scan.size,
+                 scale_, start, scan_time_, config_.inverted, angle_min_, angle_max_,
+                 config_.frame_id, config_.message_pool_size > 0 ? &scan_pool_ : NULL,
+                 timed ? &timing : NULL);
+  }
+  else {
+    // The scan topic's diagnostics still speak for the laser
+    scan_pub_->tick(start);
+    timing.convert_ns = 0;
+    timing.publish_ns = 0;
+  }
+  if (cloud_)
+    cloud_->publish(scan.ranges, scan.size, start);
+  if (status_)
+    status_->publish(scan, start);
+  for (size_t i = 0; i < decimated_.size(); i++)
+    decimated_[i]->publish(scan.ranges, scan.size, start);
+  if (encoder_)
+    publishCompressed(scan, start);
+  if (history_)
+    history_->add(scan, start.toNSec());
+  if (!timed)
+    return;
+
+  int64_t latency_ns = (ros::Time::now() - start).toNSec();
+  uint64_t read_ns = scan.read_end_ns - scan.read_begin_ns;
+  uint64_t interval_ns = last_read_end_ns_ ? scan.read_end_ns - last_read_end_ns_ : 0;
+  last_read_end_ns_ = scan.read_end_ns;
+
+  if (config_.instrumentation) {
+    read_time_.record(read_ns);
+    if (!filters_.empty())
+      filter_time_.record(filter_ns);
+    convert_time_.record(timing.convert_ns);
+    publish_time_.record(timing.publish_ns);
+    latency_.record(latency_ns > 0 ? latency_ns : 0);
+    if (interval_ns)
+      interval_.record(interval_ns);
+  }
+  if (trace_.isOpen()) {
+    PlsTraceRecord record;
+    record.stamp_ns = start.toNSec();
+    record.read_ns = PlsTraceWriter::saturate(read_ns);
+    record.convert_ns = PlsTraceWriter::saturate(timing.convert_ns);
+    record.publish_ns = PlsTraceWriter::saturate(timing.publish_ns);
+    record.latency_ns = PlsTraceWriter::saturate(latency_ns > 0 ? latency_ns : 0);
+    record.interval_ns = PlsTraceWriter::saturate(interval_ns);
+    record.num_ranges = scan.size;
+    record.flags = 0;
+    if (!trace_.append(record)) {
+      ROS_WARN("Stopped writing the timing trace: %s", trace_.error().c_str());
+      trace_.close();
+    }
+  }
+}
+
+bool PlsDevice::historyService(GetScanHistory::Request &req, GetScanHistory::Response &res)
+{
+  // Answered with the history locked, so no scan is copied twice on the way
+  ScanHistory::Visitor visit = boost::bind(&PlsDevice::appendHistoryScan, this,
+                                           boost::ref(res.scans), _1, _2);
+  uint64_t stamp_ns = req.stamp.toNSec();
+  switch (req.mode) {
+  case GetScanHistory::Request::NEAREST:
+    history_->nearest(stamp_ns, visit);
+    break;
+  case GetScanHistory::Request::BRACKET:
+    history_->bracket(stamp_ns, visit);
+    break;
+  case GetScanHistory::Request::LATEST: {
+    size_t n = req.count ? std::min<size_t>(req.count, history_->capacity()) : history_->capacity();
+    res.scans.reserve(n);
+    history_->latest(n, visit);
+    break;
+  }
+  default:
+    ROS_WARN("Unknown scan history request mode %d.", req.mode);
+    return false;
+  }
+  history_queries_++;
+  return true;
+}
+
+void PlsDevice::appendHistoryScan(std::vector<sensor_msgs::LaserScan> &scans, const PlsScan &scan,
+                                  uint64_t stamp_ns)
+{
+  if (scan.size == 0)
+    return;
+  scans.push_back(sensor_msgs::LaserScan());
+  sensor_msgs::LaserScan &msg = scans.back();
+  fill_scan_metadata(msg, scan.size, scale_, scan_time_, config_.inverted, angle_min_, angle_max_,
+                     config_.frame_id);
+  msg.header.stamp.fromNSec(stamp_ns);
+  history_converter_(scan.ranges, &msg.ranges[0], scan.size, (float)scale_);
+}
+
+void PlsDevice::publishCompressed(const PlsScan &scan, const ros::Time &start)
+{
+  // Nobody to stay in step with; whoever subscribes starts from a keyframe.
+  if (compressed_pub_.getNumSubscribers() == 0) {
+    encoder_->requestKeyframe();
+    return;
+  }
+  if (keyframe_requested_) {
+    keyframe_requested_ = false;
+    encoder_->requestKeyframe();
+  }
+  if (scan.size != compressed_msg_.num_ranges)
+    fill_compressed_metadata(compressed_msg_, scan.size, scale_, scan_time_, config_.inverted,
+                             angle_min_, angle_max_, config_.frame_id);
+
+  ScanDeltaFrame frame = encoder_->encode(scan.ranges, scan.size, compressed_msg_.data);
+  uncompressed_bytes_ += scan.size * sizeof(float);
+  if (frame == SCAN_DELTA_UNCHANGED) {
+    compressed_unchanged_++;
+    return;
+  }
+  if (frame == SCAN_DELTA_KEYFRAME)
+    compressed_keyframes_++;
+  else
+    compressed_deltas_++;
+  compressed_bytes_ += compressed_msg_.data.size();
+
+  compressed_msg_.header.stamp = start;
+  compressed_msg_.frame = encoder_->frame();
+  compressed_msg_.keyframe = frame == SCAN_DELTA_KEYFRAME;
+  compressed_pub_.publish(compressed_msg_);
+}
+
+void PlsDevice::connectionStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  boost::mutex::scoped_lock lock(status_mutex_);
+  if (connected_)
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Connected");
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Reconnecting");
+  stat.add("Port", config_.port);
+  stat.add("Baud rate", config_.baud);
+  stat.add("Connected via", used_cached_baud_ ? "cached baud rate" : "full probe");
+  stat.add("Reconnects", reconnects_);
+  stat.add("Last error", last_error_.empty() ? std::string("none") : last_error_);
+}
+
+void PlsDevice::streamStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  if (stream_->crcErrors() > 0)
+    stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Checksum errors on the serial link");
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Streaming");
+  stat.add("Telegrams", stream_->telegrams());
+  stat.add("Checksum errors", stream_->crcErrors());
+  stat.add("Bytes discarded", stream_->bytesDiscarded());
+  stat.add("Bytes read", stream_->bytesRead());
+  stat.add("Reads", stream_->reads());
+}
+
+void PlsDevice::realtimeStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  boost::mutex::scoped_lock lock(status_mutex_);
+  bool acquisition = reader_ && acquisition_tuning_.requested();
+  bool monitor = monitor_tuning_.requested();
+  if ((acquisition && !acquisition_tuning_.granted()) || (monitor && !monitor_tuning_.granted()) ||
+      (config_.lock_memory && !memory_locked_))
+    stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Real-time settings not granted");
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Real-time settings granted");
+  if (reader_)
+    stat.add("Acquisition thread", acquisition ? acquisition_tuning_.describe() : std::string("not tuned"));
+  if (!config_.streaming)
+    stat.add("Monitor thread", monitor ? monitor_tuning_.describe() : std::string("not tuned"));
+  if (!config_.lock_memory)
+    stat.add("Memory locked", "not requested");
+  else
+    stat.add("Memory locked", memory_locked_ ? std::string("yes") : "no (" + memory_error_ + ")");
+}
+
+void PlsDevice::compressionStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Publishing compressed scans");
+  stat.add("Topic", compressed_pub_.getTopic());
+  stat.add("Keyframes", compressed_keyframes_);
+  stat.add("Deltas", compressed_deltas_);
+  stat.add("Unchanged scans", compressed_unchanged_);
+  stat.add("Compression ratio", compressed_bytes_ ? (double)uncompressed_bytes_ / compressed_bytes_ : 0.0);
+}
+
+void PlsDevice::interleaveStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  // Every broken set is a frame missed or a reconnect; a steady stream of
+  // them means the phases are probably being merged out of order.
+  unsigned long merged = interleaver_->merged(), broken = interleaver_->broken();
+  if (broken > merged / 10)
+    stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Many interleaved sets are incomplete");
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Merging interleaved scans");
+  stat.add("Scans per set", interleaver_->factor());
+  stat.add("Merged scans", merged);
+  stat.add("Broken sets", broken);
+}
+
+void PlsDevice::fieldStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  int state = field_state_;
+  if (state < 0)
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "No scans checked yet");
+  else if (state > 0)
+    stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Protective field intruded");
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Protective field clear");
+  stat.add("Topic", field_pub_.getTopic());
+  stat.add("Readings inside", field_readings_);
+  stat.add("Minimum readings to trip", config_.field_min_readings);
+  stat.add("Trips", field_trips_);
+  stat.add("Signal failures", field_signal_.failures());
+}
+
+void PlsDevice::udpStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  if (udp_->dropped())
+    stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Dropping UDP datagrams");
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Sending scans over UDP");
+  stat.add("Sensor id", config_.udp_sensor_id);
+  stat.add("Scans queued", udp_sequence_);
+  // The rest is shared by every laser on the socket
+  stat.add("Datagrams sent", udp_->sent());
+  stat.add("Datagrams dropped", udp_->dropped());
+  stat.add("Batches sent", udp_->flushes());
+}
+
+void PlsDevice::historyStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  uint64_t oldest_ns, newest_ns;
+  size_t held = history_->size();
+  if (history_->span(oldest_ns, newest_ns))
+    stat.summaryf(diagnostic_msgs::DiagnosticStatus::OK, "%u scans over %.2f s", (unsigned)held,
+                  (newest_ns - oldest_ns) * 1e-9);
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "No scans yet");
+  stat.add("Service", history_srv_.getService());
+  stat.add("Capacity", history_->capacity());
+  stat.add("Queries", history_queries_);
+  stat.add("Restarts (clock went back)", history_->restarts());
+}
+
+void PlsDevice::watchdogStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  if (stalled_)
+    stat.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Stale data: the laser has stopped sending scans");
+  else
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Scans arriving");
+  stat.add("Deadline (ms)", watchdog_deadline_ns_ * 1e-6);
+  stat.add("Stalls", stalls_);
+}
+
+void PlsDevice::loopTimingStatus(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+  stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Timing the driver loop");
+  stat.add("Scans timed", latency_.count());
+  add_histogram(stat, "Serial read", read_time_);
+  if (!filters_.empty())
+    add_histogram(stat, "Filters", filter_time_);
+  add_histogram(stat, "Conversion", convert_time_);
+  add_histogram(stat, "Publish", publish_time_);
+  add_histogram(stat, "Scan to publish", latency_);
+  add_histogram(stat, "Scan interval", interval_);
+  stat.add("Trace file", trace_.isOpen() ? config_.trace_file : std::string("none"));
+}
+
+int PlsDevice::drain()
+{
+  int published = 0;
+  PlsScan *scan;
+  while (reader_ && reader_->pop(scan)) {
+    publish(*scan);
+    reader_->release(scan);
+    published++;
+  }
+  return published;
+}
+
+bool PlsDevice::waitAndPublish(int timeout_ms)
+{
+  PlsScan *scan;
+  if (!reader_ || !reader_->waitForScan(scan, timeout_ms))
+    return false;
+  publish(*scan);
+  reader_->release(scan);
+  return true;
+}
+
+void PlsDevice::readAndPublish()
+{
+  if (readScan(*direct_scan_))
+    publish(*direct_scan_);
+}
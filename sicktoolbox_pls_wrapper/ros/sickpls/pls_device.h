@@ -0,0 +1,349 @@
+///////////////////////////////////////////////////////////////////////////////
+// one PLS as the driver sees it: the sicktoolbox handle, the thread and
+// queue that read scans from it, and the topic and diagnostics they go out on.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_PLS_DEVICE_H
+#define SICKTOOLBOX_PLS_WRAPPER_PLS_DEVICE_H
+
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <sickpls/SickPLS.hh>
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include <sicktoolbox_pls_wrapper/GetScanHistory.h>
+#include <diagnostic_updater/diagnostic_updater.h> // Publishing over the diagnostics channels.
+#include <diagnostic_updater/publisher.h>
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <sicktoolbox_pls_wrapper/pls_baud.h>
+#include <sicktoolbox_pls_wrapper/protective_field.h>
+#include <sicktoolbox_pls_wrapper/pls_scan.h>
+#include <sicktoolbox_pls_wrapper/pls_shm.h>
+#include <sicktoolbox_pls_wrapper/pls_stream.h>
+#include <sicktoolbox_pls_wrapper/pls_trace.h>
+#include <sicktoolbox_pls_wrapper/pls_udp.h>
+#include <sicktoolbox_pls_wrapper/realtime.h>
+#include <sicktoolbox_pls_wrapper/scan_delta.h>
+#include <sicktoolbox_pls_wrapper/scan_filters.h>
+#include <sicktoolbox_pls_wrapper/scan_history.h>
+#include <sicktoolbox_pls_wrapper/scan_interleaver.h>
+#include <sicktoolbox_pls_wrapper/scan_ring.h>
+#include <sicktoolbox_pls_wrapper/scan_timestamper.h>
+#include "param_snapshot.h"
+#include "scan_publisher.h"
+
+// Owns the thread that does nothing but read scans from the laser and queue
+// them, so that a slow publish or diagnostics update can't make us miss
+// frames. Every queued scan is signalled on an eventfd, so one publisher
+// thread can wait on any number of readers with epoll.
+class ScanReader
+{
+public:
+  // read fills in the next scan, or returns false if there wasn't one
+  // (e.g. because the laser is being reconnected).
+  typedef boost::function<bool (sicktoolbox_pls_wrapper::PlsScan &)> ReadFunction;
+
+  ScanReader(const ReadFunction &read, size_t queue_size,
+             sicktoolbox_pls_wrapper::OverflowPolicy policy);
+  ~ScanReader();
+
+  void start();
+  void stop();
+
+  // Run first thing on the reader thread, before it reads anything.
+  void setThreadSetup(const boost::function<void ()> &setup) { setup_ = setup; }
+
+  // Readable whenever there may be scans queued.
+  int eventFd() const { return event_fd_; }
+  // Waits up to timeout_ms for a queued scan and takes it off the queue.
+  // The scan is the caller's until it is given back with release.
+  bool waitForScan(sicktoolbox_pls_wrapper::PlsScan *&scan, int timeout_ms);
+  // Takes the oldest queued scan without waiting.
+  bool pop(sicktoolbox_pls_wrapper::PlsScan *&scan);
+  void release(sicktoolbox_pls_wrapper::PlsScan *scan) { pool_.release(scan); }
+
+  bool failed() const { return failed_; }
+
+  void queueStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+
+private:
+  void run();
+  void signal();
+
+  ReadFunction read_;
+  boost::function<void ()> setup_;
+  sicktoolbox_pls_wrapper::ScanRing<sicktoolbox_pls_wrapper::PlsScan *> ring_;
+  sicktoolbox_pls_wrapper::PlsScanPool pool_;
+  boost::thread thread_;
+  int event_fd_;
+  volatile bool running_;
+  volatile bool failed_;
+};
+
+// Everything that is configured per laser.
+struct PlsDeviceConfig
+{
+  std::string name;  // empty for the classic single-laser node
+  std::string port;
+  int baud;
+  bool inverted;
+  std::string frame_id;
+  std::string topic;
+  bool acquisition_thread;
+  int scan_queue_size;
+  sicktoolbox_pls_wrapper::OverflowPolicy overflow_policy;
+  bool filter_timestamps;
+  int message_pool_size;
+  bool instrumentation;
+  std::string trace_file;
+  bool reconnect;
+  int power_on_delay;
+  std::string baud_cache_dir;
+  bool streaming;
+  std::vector<std::string> filters;
+  int temporal_median_window;
+  int spatial_median_window;
+  double shadow_min_angle; // degrees
+  double shadow_max_angle;
+  int shadow_window;
+  int interleave;
+  bool publish_compressed;
+  std::string compressed_topic;
+  int keyframe_interval;
+  int compression_deadband;
+  std::vector<DecimatedTopicConfig> decimated_topics;
+  bool publish_scan;
+  bool publish_cloud;
+  std::string cloud_topic;
+  bool dense_cloud;
+  bool publish_status;
+  std::string status_topic;
+  std::string shm_name;
+  int shm_slots;
+  std::vector<int> acquisition_cpus;
+  int acquisition_priority;
+  std::vector<int> monitor_cpus;
+  int monitor_priority;
+  bool lock_memory;
+  // ~protective_field
+  std::vector<double> field_polygon; // x0, y0, x1, y1, ... (m)
+  std::vector<double> field_sectors; // angle_min, angle_max (degrees), range (m), ...
+  int field_min_readings;
+  std::string field_topic;
+  std::string field_udp;
+  std::string field_gpio_file;
+  bool field_trip_on_loss;
+  int udp_sensor_id;
+  int watchdog_periods;
+  int history_size;
+  std::string history_service;
+
+  // Reads the per-laser parameters from a snapshot of their namespace.
+  void load(const ParamSnapshot &params);
+};
+
+class PlsDevice
+{
+public:
+  // params is the laser's namespace, for its diagnostic settings.
+  PlsDevice(const PlsDeviceConfig &config, const ParamSnapshot &params);
+  ~PlsDevice();
+
+  const PlsDeviceConfig &config() const { return config_; }
+
+  // Bringing a laser up is three steps. open() talks only to the laser and
+  // advertise() only to ROS, so the slow serial probe can run on a thread
+  // of its own while the other goes on; setup() then needs both done.
+  //
+  // open() opens the laser and throws whatever sicktoolbox throws. Returns
+  // false if the laser works but isn't usable (e.g. unsupported units).
+  bool open();
+  void advertise(ros::NodeHandle &nh);
+  void setup();
+  // Where to send scans as datagrams, if anywhere; the caller owns it and
+  // flushes it. Set before setup().
+  void setUdpSender(sicktoolbox_pls_wrapper::PlsUdpSender *sender) { udp_ = sender; }
+  // All three, one after the other.
+  bool initialize(ros::NodeHandle &nh);
+  void uninitialize();
+
+  // Reads the next scan into scan. If reading times out or the port fails
+  // this reconnects instead of throwing, unless ~reconnect is off. Returns
+  // false if there's no scan yet.
+  bool readScan(sicktoolbox_pls_wrapper::PlsScan &scan);
+
+  // Threaded acquisition: start() the reader, then drain() whenever
+  // eventFd() is readable.
+  void start();
+  void stop();
+  int eventFd() const { return reader_ ? reader_->eventFd() : -1; }
+  // Publishes every queued scan. Returns the number published.
+  int drain();
+  // Waits up to timeout_ms for a queued scan and publishes it.
+  bool waitAndPublish(int timeout_ms);
+  bool failed() const { return reader_ && reader_->failed(); }
+
+  // Unthreaded acquisition: read one scan and publish it.
+  void readAndPublish();
+
+  void updateDiagnostics() { updater_.update(); }
+
+private:
+  void connect();
+  void connectLaser();
+  void tuneAcquisitionThread();
+  bool reconnect();
+  void lost(const char *what);
+  void buildFilters();
+  void checkField(const sicktoolbox_pls_wrapper::PlsScan &scan);
+  void setFieldState(bool intruded, uint32_t readings, uint64_t stamp_ns);
+  void publish(sicktoolbox_pls_wrapper::PlsScan &scan);
+  void queueUdp(const sicktoolbox_pls_wrapper::PlsScan &scan, const ros::Time &start);
+  void publishCompressed(const sicktoolbox_pls_wrapper::PlsScan &scan, const ros::Time &start);
+  void compressedSubscriberConnected(const ros::SingleSubscriberPublisher &) { keyframe_requested_ = true; }
+  void connectionStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+  void streamStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+  void realtimeStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+  void compressionStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+  void interleaveStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+  void fieldStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+  void udpStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+  void watchdogStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+  void historyStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+  bool historyService(sicktoolbox_pls_wrapper::GetScanHistory::Request &req,
+                      sicktoolbox_pls_wrapper::GetScanHistory::Response &res);
+  void appendHistoryScan(std::vector<sensor_msgs::LaserScan> &scans,
+                         const sicktoolbox_pls_wrapper::PlsScan &scan, uint64_t stamp_ns);
+  void watch();
+  void stopWatchdog();
+  void publishWatchdog(uint64_t silent_ns);
+  void loopTimingStatus(diagnostic_updater::DiagnosticStatusWrapper &stat);
+
+  PlsDeviceConfig config_;
+  boost::scoped_ptr<SickToolbox::SickPLS> sick_pls_;
+  boost::scoped_ptr<sicktoolbox_pls_wrapper::PlsStream> stream_; // instead of sick_pls_ with ~streaming
+  sicktoolbox_pls_wrapper::BaudCache baud_cache_;
+  diagnostic_updater::Updater updater_;
+  ScanDiagnosticParams diagnostic_params_;
+  boost::scoped_ptr<diagnostic_updater::DiagnosedPublisher<sensor_msgs::LaserScan> > scan_pub_;
+  boost::scoped_ptr<ScanReader> reader_;
+  LaserScanPool scan_pool_;
+  sicktoolbox_pls_wrapper::ScanTimestamper timestamper_;
+  double scale_;
+  double scan_time_;
+  float angle_min_;
+  float angle_max_;
+  // What readAndPublish reads into, when there's no acquisition thread;
+  // a pool of one because new doesn't honour a PlsScan's alignment.
+  sicktoolbox_pls_wrapper::PlsScanPool direct_scans_;
+  sicktoolbox_pls_wrapper::PlsScan *direct_scan_;
+  sicktoolbox_pls_wrapper::ScanFilterChain filters_;
+  // With ~interleave, the scan topic gets one message per merged set, from
+  // a pool of its own since its messages are a different size.
+  boost::scoped_ptr<sicktoolbox_pls_wrapper::ScanInterleaver> interleaver_;
+  LaserScanPool interleaved_pool_;
+  // One per ~decimated_topics entry
+  std::vector<boost::shared_ptr<DecimatedScanPublisher> > decimated_;
+  boost::scoped_ptr<CloudPublisher> cloud_;
+  boost::scoped_ptr<StatusPublisher> status_;
+  sicktoolbox_pls_wrapper::PlsShmWriter shm_;
+  sicktoolbox_pls_wrapper::PlsUdpSender *udp_;
+  uint32_t udp_sequence_;
+
+  // The protective field is checked as soon as a scan is read, on the
+  // acquisition thread when there is one; the diagnostics only read the
+  // counters.
+  sicktoolbox_pls_wrapper::ProtectiveField field_;
+  sicktoolbox_pls_wrapper::ProtectiveFieldSignal field_signal_;
+  ros::Publisher field_pub_;
+  volatile int field_state_; // -1 until the first scan, then 0 clear or 1 intruded
+  volatile uint32_t field_readings_;
+  unsigned long field_trips_;
+
+  // The scans as published, for the history service, which answers from
+  // whichever thread spins the callbacks.
+  boost::scoped_ptr<sicktoolbox_pls_wrapper::ScanHistory> history_;
+  ros::ServiceServer history_srv_;
+  sicktoolbox_pls_wrapper::RangeConverter history_converter_;
+  volatile unsigned long history_queries_;
+
+  // The compressed topic, when there is one; all on the publishing thread
+  // apart from keyframe_requested_, which a new subscriber sets.
+  ros::Publisher compressed_pub_;
+  boost::scoped_ptr<sicktoolbox_pls_wrapper::ScanDeltaEncoder> encoder_;
+  sicktoolbox_pls_wrapper::CompressedScan compressed_msg_;
+  volatile bool keyframe_requested_;
+  unsigned long compressed_keyframes_;
+  unsigned long compressed_deltas_;
+  unsigned long compressed_unchanged_;
+  uint64_t compressed_bytes_;
+  uint64_t uncompressed_bytes_;
+
+  // Connection state. readScan runs on the acquisition thread when there is
+  // one, so what the diagnostics read is guarded by status_mutex_.
+  volatile bool connected_;
+  volatile bool reconnected_;
+  uint64_t last_attempt_ns_;
+  boost::mutex status_mutex_;
+  bool used_cached_baud_;
+  unsigned long reconnects_;
+  std::string last_error_;
+
+  // What the scheduler granted the threads reading the laser, guarded by
+  // status_mutex_ like the connection state.
+  sicktoolbox_pls_wrapper::ThreadTuning acquisition_tuning_;
+  sicktoolbox_pls_wrapper::ThreadTuning monitor_tuning_;
+  bool memory_locked_;
+  std::string memory_error_;
+
+  // The watchdog notices a laser gone quiet from its own thread, since the
+  // one reading it may be stuck in the read: it publishes the stall to
+  // /diagnostics right away rather than at the updater's next turn.
+  boost::thread watchdog_;
+  ros::Publisher diagnostics_pub_;
+  uint64_t watchdog_deadline_ns_;
+  volatile uint64_t last_scan_ns_;
+  volatile bool stalled_;
+  volatile unsigned long stalls_;
+  double stream_timeout_; // seconds PlsStream::next waits for a scan
+
+  // Driver loop instrumentation, all recorded and read on the publishing
+  // thread.
+  sicktoolbox_pls_wrapper::LatencyHistogram read_time_;
+  sicktoolbox_pls_wrapper::LatencyHistogram filter_time_;
+  sicktoolbox_pls_wrapper::LatencyHistogram convert_time_;
+  sicktoolbox_pls_wrapper::LatencyHistogram publish_time_;
+  sicktoolbox_pls_wrapper::LatencyHistogram latency_;
+  sicktoolbox_pls_wrapper::LatencyHistogram interval_;
+  uint64_t last_read_end_ns_;
+  sicktoolbox_pls_wrapper::PlsTraceWriter trace_;
+};
+
+#endif
@@ -0,0 +1,321 @@
+///////////////////////////////////////////////////////////////////////////////
+// republishes scans recorded by log_scans (binary or ASCII) through the
+// same publishing path and diagnostics as the driver, at the recorded rate,
+// a multiple of it, or as fast as possible.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+#include <string>
+#include <boost/scoped_ptr.hpp>
+#include <sickpls/SickPLS.hh>
+#include <sicktoolbox_pls_wrapper/pls_log.h>
+#include <sicktoolbox_pls_wrapper/pls_scan.h>
+#include "scan_publisher.h"
+using namespace SickToolbox;
+using namespace std;
+using namespace sicktoolbox_pls_wrapper;
+
+// A log being read back one scan at a time.
+class LogSource
+{
+public:
+  virtual ~LogSource() {}
+  // Fills in the ranges and host stamp of the next scan. Returns false at
+  // the end of the log.
+  virtual bool next(PlsScan &scan) = 0;
+  virtual bool rewind() = 0;
+  // Metres per raw reading.
+  virtual double scale() const = 0;
+};
+
+class BinaryLogSource : public LogSource
+{
+public:
+  bool open(const string &path)
+  {
+    if (!reader_.open(path)) {
+      ROS_ERROR("%s", reader_.error().c_str());
+      return false;
+    }
+    next_ = 0;
+    return true;
+  }
+
+  bool next(PlsScan &scan)
+  {
+    if (next_ >= reader_.size())
+      return false;
+    const PlsLogRecord &record = reader_[next_++];
+    scan.clear();
+    scan.host_stamp_ns = record.stamp_ns;
+    scan.size = std::min<uint32_t>(record.num_ranges, PlsScan::MAX_READINGS);
+    const uint16_t *ranges = record.ranges();
+    for (uint32_t i = 0; i < scan.size; i++)
+      scan.ranges[i] = ranges[i];
+    const PlsLogHeader &header = reader_.header();
+    if ((header.flags & PLS_LOG_STATUS) && (record.flags & PLS_RECORD_STATUS)) {
+      memcpy(scan.status, record.status(header.ranges_per_record), scan.size);
+      scan.fields |= PlsScan::STATUS;
+    }
+    else {
+      scan.deriveStatus();
+    }
+    if (record.flags & PLS_RECORD_DEVICE_STATUS) {
+      scan.device_status = record.device_status;
+      scan.fields |= PlsScan::DEVICE_STATUS;
+    }
+    return true;
+  }
+
+  bool rewind()
+  {
+    next_ = 0;
+    return true;
+  }
+
+  double scale() const
+  {
+    if (reader_.header().units != SickPLS::SICK_MEASURING_UNITS_CM)
+      ROS_WARN_ONCE("Log doesn't record its measuring units, assuming cm.");
+    return 0.01;
+  }
+
+private:
+  PlsLogReader reader_;
+  uint64_t next_;
+};
+
+// "%.6f %d %d ...\n" per scan, as written by log_scans --ascii.
+class AsciiLogSource : public LogSource
+{
+public:
+  AsciiLogSource() : file_(NULL), line_(NULL), line_size_(0) {}
+
+  ~AsciiLogSource()
+  {
+    if (file_)
+      fclose(file_);
+    free(line_);
+  }
+
+  bool open(const string &path)
+  {
+    file_ = fopen(path.c_str(), "r");
+    if (!file_) {
+      ROS_ERROR("couldn't open %s", path.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  bool next(PlsScan &scan)
+  {
+    while (getline(&line_, &line_size_, file_) >= 0) {
+      char *p = line_;
+      char *end;
+      double stamp = strtod(p, &end);
+      if (end == p)
+        continue; // blank or garbled line
+      p = end;
+      scan.size = 0;
+      while (scan.size < PlsScan::MAX_READINGS) {
+        unsigned long value = strtoul(p, &end, 10);
+        if (end == p)
+          break;
+        scan.ranges[scan.size++] = value;
+        p = end;
+      }
+      if (scan.size == 0)
+        continue;
+      scan.host_stamp_ns = (uint64_t)(stamp * 1e9 + 0.5);
+      scan.fields = 0;
+      scan.deriveStatus();
+      return true;
+    }
+    return false;
+  }
+
+  bool rewind()
+  {
+    return fseek(file_, 0, SEEK_SET) == 0;
+  }
+
+  double scale() const
+  {
+    return 0.01; // log_scans only records in cm
+  }
+
+private:
+  FILE *file_;
+  char *line_;
+  size_t line_size_;
+};
+
+static bool is_binary_log(const char *path)
+{
+  char magic[sizeof(PLS_LOG_MAGIC)];
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return false;
+  bool binary = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+    memcmp(magic, PLS_LOG_MAGIC, sizeof(magic)) == 0;
+  fclose(f);
+  return binary;
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "pls_replay");
+  if (argc != 2)
+  {
+    printf("Usage: pls_replay LOGFILE\n");
+    return 1;
+  }
+  ros::NodeHandle nh;
+  ros::NodeHandle nh_ns("~");
+  ParamSnapshot params(nh_ns);
+
+  // Playback rate as a multiple of the recorded rate; 0 replays as fast as
+  // the scans can be published.
+  double rate;
+  params.param("rate", rate, 1.0);
+  bool loop;
+  params.param("loop", loop, false);
+  // Publish with the recorded stamps instead of restamping at playback.
+  bool original_stamps;
+  params.param("original_stamps", original_stamps, false);
+  bool inverted;
+  params.param("inverted", inverted, false);
+  std::string frame_id;
+  params.param<std::string>("frame_id", frame_id, "laser");
+  int message_pool_size;
+  params.param("message_pool_size", message_pool_size, 0);
+  // The status bits the log kept, on scan_status as the driver publishes them.
+  bool publish_status;
+  params.param("publish_status", publish_status, false);
+  bool as_fast_as_possible = rate <= 0;
+
+  ScanDiagnosticParams diagnostic_params;
+  diagnostic_params.load(params, as_fast_as_possible ? 75.0 : 75.0 * rate);
+  diagnostic_updater::Updater updater;
+  updater.setHardwareID(diagnostic_params.hardware_id);
+  diagnostic_updater::DiagnosedPublisher<sensor_msgs::LaserScan> scan_pub(nh.advertise<sensor_msgs::LaserScan>("scan", 10), updater,
+                                                                          diagnostic_params.frequencyStatusParam(),
+                                                                          diagnostic_params.timeStampStatusParam());
+  load_use_rep_117(nh, params);
+
+  BinaryLogSource binary_source;
+  AsciiLogSource ascii_source;
+  LogSource *source;
+  if (is_binary_log(argv[1]))
+  {
+    if (!binary_source.open(argv[1]))
+      return 1;
+    source = &binary_source;
+  }
+  else
+  {
+    if (!ascii_source.open(argv[1]))
+      return 1;
+    source = &ascii_source;
+  }
+
+  const double scale = source->scale();
+  const double scan_time = 1.0 / 75;
+  const float angle_min = -M_PI/2;
+  const float angle_max = M_PI/2;
+  LaserScanPool scan_pool(std::max(message_pool_size, 1));
+  scan_pool.configure(scale, scan_time, inverted, angle_min, angle_max, frame_id);
+  LaserScanPool *pool = message_pool_size > 0 ? &scan_pool : NULL;
+  boost::scoped_ptr<StatusPublisher> status_pub;
+  if (publish_status) {
+    status_pub.reset(new StatusPublisher(nh, "scan_status"));
+    status_pub->configure(frame_id);
+  }
+
+  PlsScan scan;
+  uint64_t first_stamp_ns = 0;
+  bool first = true;
+  ros::WallTime run_start = ros::WallTime::now();
+  ros::WallTime playback_start = run_start;
+  ros::WallTime report_start = run_start;
+  unsigned long published = 0;
+  unsigned long report_published = 0;
+
+  while (ros::ok()) {
+    if (!source->next(scan)) {
+      if (!loop || !source->rewind() || !source->next(scan))
+        break;
+      first = true;
+    }
+    if (first) {
+      first_stamp_ns = scan.host_stamp_ns;
+      playback_start = ros::WallTime::now();
+      first = false;
+    }
+
+    if (!as_fast_as_possible) {
+      double due = (scan.host_stamp_ns - first_stamp_ns) * 1e-9 / rate;
+      double wait = due - (ros::WallTime::now().toSec() - playback_start.toSec());
+      if (wait > 0)
+        ros::WallDuration(wait).sleep();
+    }
+
+    // The log holds the time each scan was read, like end_of_scan in the
+    // driver, so the start of the scan is half a scan time earlier.
+    ros::Time end_of_scan = ros::Time::now();
+    if (original_stamps)
+      end_of_scan.fromNSec(scan.host_stamp_ns);
+    ros::Time start = end_of_scan - ros::Duration(scan_time / 2.0);
+    publish_scan(&scan_pub, scan.ranges, scan.size, scale, start, scan_time, inverted,
+                 angle_min, angle_max, frame_id, pool);
+    if (status_pub)
+      status_pub->publish(scan, start);
+    published++;
+    ros::spinOnce();
+    updater.update();
+
+    if (as_fast_as_possible) {
+      double elapsed = ros::WallTime::now().toSec() - report_start.toSec();
+      if (elapsed >= 1.0) {
+        printf("%.1f scans/s\n", (published - report_published) / elapsed);
+        fflush(stdout);
+        report_start = ros::WallTime::now();
+        report_published = published;
+      }
+    }
+  }
+
+  double total = ros::WallTime::now().toSec() - run_start.toSec();
+  if (as_fast_as_possible && total > 0)
+    printf("published %lu scans in %.2f s, %.1f scans/s sustained\n", published, total, published / total);
+  return 0;
+}
@@ -0,0 +1,387 @@
+///////////////////////////////////////////////////////////////////////////////
+// turning raw PLS readings into LaserScan messages.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <sicktoolbox_pls_wrapper/range_conversion.h>
+#include "scan_publisher.h"
+using namespace std;
+using namespace sicktoolbox_pls_wrapper;
+
+// Tick-tock transition variable, controls if the driver outputs NaNs and Infs
+bool use_rep_117_;
+
+void load_use_rep_117(ros::NodeHandle &nh, const ParamSnapshot &params)
+{
+  // A private setting came with the rest of the node's parameters;
+  // otherwise search for it as before.
+  std::string key;
+  if (!params.getParam("use_rep_117", use_rep_117_)) {
+    if (nh.searchParam("use_rep_117", key))
+      nh.getParam(key, use_rep_117_);
+    else
+      use_rep_117_ = false;
+  }
+
+  if(!use_rep_117_){ // Warn the user that they need to update their code.
+    ROS_WARN("The use_rep_117 parameter has not been set or is set to false.  Please see: http://ros.org/wiki/rep_117/migration");
+  }
+}
+
+void ScanDiagnosticParams::load(const ParamSnapshot &params, double default_freq)
+{
+  params.param<double>("desired_frequency", desired_freq, default_freq);
+  params.param<double>("min_frequency", min_freq, desired_freq);
+  params.param<double>("max_frequency", max_freq, desired_freq);
+  params.param<double>("frequency_tolerance", freq_tolerance, 0.3);
+  params.param<int>("window_size", window_size, 30);
+  params.param<double>("min_acceptable_delay", min_delay, 0.0);
+  params.param<double>("max_acceptable_delay", max_delay, 0.2);
+  params.param<std::string>("hardware_id", hardware_id, "SICK PLS");
+}
+
+void fill_scan_metadata(sensor_msgs::LaserScan &scan_msg, uint32_t n_range_values, double scale,
+                        double scan_time, bool inverted, float angle_min,
+                        float angle_max, const std::string &frame_id)
+{
+  scan_msg.header.frame_id = frame_id;
+  if (inverted) {
+    scan_msg.angle_min = angle_max;
+    scan_msg.angle_max = angle_min;
+  } else {
+    scan_msg.angle_min = angle_min;
+    scan_msg.angle_max = angle_max;
+  }
+  scan_msg.angle_increment = (scan_msg.angle_max - scan_msg.angle_min) / (double)(n_range_values-1);
+  scan_msg.scan_time = scan_time;
+  scan_msg.time_increment = scan_time / (2*M_PI) * scan_msg.angle_increment;
+  scan_msg.range_min = 0;
+  switch (range_units(scale)) {
+  case RANGE_UNITS_CM:
+    scan_msg.range_max = 81;
+    break;
+  case RANGE_UNITS_MM:
+    scan_msg.range_max = 8.1;
+    break;
+  default:
+    break;
+  }
+  scan_msg.ranges.resize(n_range_values);
+}
+
+RangeConverter select_scan_converter(double scale)
+{
+  // With REP 117 the PLS's out-of-range codes (5105, 5110, ...) become +Inf;
+  // legacy output passes them through scaled like any other reading.
+  // Inverted scans keep their order and swap the angles instead.
+  return select_range_converter(range_units(scale), false, use_rep_117_);
+}
+
+void fill_scan_ranges(sensor_msgs::LaserScan &scan_msg, const uint32_t *range_values,
+                      uint32_t n_range_values, double scale)
+{
+  select_scan_converter(scale)(range_values, &scan_msg.ranges[0], n_range_values, (float)scale);
+}
+
+void fill_compressed_metadata(sicktoolbox_pls_wrapper::CompressedScan &msg, uint32_t n_range_values,
+                              double scale, double scan_time, bool inverted, float angle_min,
+                              float angle_max, const std::string &frame_id)
+{
+  sensor_msgs::LaserScan scan_msg;
+  fill_scan_metadata(scan_msg, n_range_values, scale, scan_time, inverted, angle_min, angle_max, frame_id);
+  msg.header.frame_id = scan_msg.header.frame_id;
+  msg.angle_min = scan_msg.angle_min;
+  msg.angle_max = scan_msg.angle_max;
+  msg.angle_increment = scan_msg.angle_increment;
+  msg.time_increment = scan_msg.time_increment;
+  msg.scan_time = scan_msg.scan_time;
+  msg.range_min = scan_msg.range_min;
+  msg.range_max = scan_msg.range_max;
+  msg.scale = scale;
+  msg.num_ranges = n_range_values;
+}
+
+void fill_scan_from_compressed(sensor_msgs::LaserScan &scan_msg,
+                               const sicktoolbox_pls_wrapper::CompressedScan &msg,
+                               const uint32_t *range_values)
+{
+  scan_msg.header = msg.header;
+  scan_msg.angle_min = msg.angle_min;
+  scan_msg.angle_max = msg.angle_max;
+  scan_msg.angle_increment = msg.angle_increment;
+  scan_msg.time_increment = msg.time_increment;
+  scan_msg.scan_time = msg.scan_time;
+  scan_msg.range_min = msg.range_min;
+  scan_msg.range_max = msg.range_max;
+  scan_msg.ranges.resize(msg.num_ranges);
+  fill_scan_ranges(scan_msg, range_values, msg.num_ranges, msg.scale);
+}
+
+LaserScanPool::LaserScanPool(size_t size)
+  : converter_(select_scan_converter(0)), pool_(size), next_(0), seq_(0), misses_(0), n_range_values_(0), scale_(0), scan_time_(0),
+    inverted_(false), angle_min_(0), angle_max_(0)
+{
+}
+
+void LaserScanPool::configure(double scale, double scan_time, bool inverted, float angle_min,
+                              float angle_max, const std::string &frame_id)
+{
+  scale_ = scale;
+  scan_time_ = scan_time;
+  inverted_ = inverted;
+  angle_min_ = angle_min;
+  angle_max_ = angle_max;
+  frame_id_ = frame_id;
+  converter_ = select_scan_converter(scale);
+  n_range_values_ = 0; // rebuilt from the first scan, once we know its size
+}
+
+sensor_msgs::LaserScanPtr LaserScanPool::acquire(uint32_t n_range_values, const ros::Time &start)
+{
+  if (n_range_values != n_range_values_)
+    rebuild(n_range_values);
+
+  sensor_msgs::LaserScanPtr msg;
+  for (size_t k = 0; k < pool_.size() && !msg; k++) {
+    size_t i = (next_ + k) % pool_.size();
+    if (pool_[i].unique()) {
+      msg = pool_[i];
+      next_ = i + 1;
+    }
+  }
+  if (!msg) {
+    // Everything is still in flight; replace the next slot rather than
+    // waiting. The old message goes away with its last holder.
+    misses_++;
+    ROS_DEBUG("LaserScan pool exhausted (%lu misses), allocating", misses_);
+    msg.reset(new sensor_msgs::LaserScan(*pool_[next_ % pool_.size()]));
+    pool_[next_ % pool_.size()] = msg;
+    next_++;
+  }
+  msg->header.stamp = start;
+  msg->header.seq = seq_++;
+  return msg;
+}
+
+void LaserScanPool::rebuild(uint32_t n_range_values)
+{
+  n_range_values_ = n_range_values;
+  sensor_msgs::LaserScan scan_msg;
+  fill_scan_metadata(scan_msg, n_range_values, scale_, scan_time_, inverted_,
+                     angle_min_, angle_max_, frame_id_);
+  for (size_t i = 0; i < pool_.size(); i++)
+    pool_[i].reset(new sensor_msgs::LaserScan(scan_msg));
+}
+
+DecimatedScanPublisher::DecimatedScanPublisher(ros::NodeHandle &nh, const DecimatedTopicConfig &config)
+  : config_(config), converter_(select_scan_converter(0)), scans_(0), n_range_values_(0), scale_(0), scan_time_(0), inverted_(false),
+    angle_min_(0), angle_max_(0)
+{
+  config_.every = std::max(config_.every, 1);
+  config_.bins = std::max(config_.bins, 1);
+  pub_ = nh.advertise<sensor_msgs::LaserScan>(config_.topic, 10);
+}
+
+void DecimatedScanPublisher::configure(double scale, double scan_time, bool inverted, float angle_min,
+                                       float angle_max, const std::string &frame_id)
+{
+  scale_ = scale;
+  converter_ = select_scan_converter(scale);
+  scan_time_ = scan_time;
+  inverted_ = inverted;
+  angle_min_ = angle_min;
+  angle_max_ = angle_max;
+  frame_id_ = frame_id;
+  n_range_values_ = 0;
+}
+
+void DecimatedScanPublisher::publish(const uint32_t *range_values, uint32_t n_range_values,
+                                     const ros::Time &start)
+{
+  // Counted whether or not anyone's listening, so the scans that go out
+  // don't depend on when they subscribed.
+  if (scans_++ % config_.every != 0 || pub_.getNumSubscribers() == 0 || n_range_values == 0)
+    return;
+  if (n_range_values != n_range_values_)
+    rebuild(n_range_values);
+
+  // Reading i of the output stands where reading i*M of the scan did;
+  // pooling takes the nearest of the M readings centred there.
+  const uint32_t m = config_.bins;
+  uint32_t n_out = range_values_.size();
+  if (!config_.min_pooling) {
+    for (uint32_t i = 0; i < n_out; i++)
+      range_values_[i] = range_values[i * m];
+  }
+  else {
+    for (uint32_t i = 0; i < n_out; i++) {
+      uint32_t begin = i * m >= m / 2 ? i * m - m / 2 : 0;
+      uint32_t end = std::min(begin + m, n_range_values);
+      uint32_t nearest = range_values[begin];
+      for (uint32_t j = begin + 1; j < end; j++)
+        nearest = std::min(nearest, range_values[j]);
+      range_values_[i] = nearest;
+    }
+  }
+
+  scan_msg_.header.stamp = start;
+  converter_(&range_values_[0], &scan_msg_.ranges[0], n_out, (float)scale_);
+  pub_.publish(scan_msg_);
+}
+
+void DecimatedScanPublisher::rebuild(uint32_t n_range_values)
+{
+  n_range_values_ = n_range_values;
+  uint32_t n_out = (n_range_values - 1) / config_.bins + 1;
+  range_values_.resize(n_out);
+  // The full scan's geometry, stretched over every Mth reading
+  fill_scan_metadata(scan_msg_, n_range_values, scale_, scan_time_, inverted_, angle_min_,
+                     angle_max_, frame_id_);
+  scan_msg_.angle_increment *= config_.bins;
+  scan_msg_.time_increment *= config_.bins;
+  scan_msg_.angle_max = scan_msg_.angle_min + (n_out - 1) * scan_msg_.angle_increment;
+  scan_msg_.ranges.resize(n_out);
+}
+
+CloudPublisher::CloudPublisher(ros::NodeHandle &nh, const std::string &topic, bool dense)
+  : dense_(dense), n_range_values_(0), scale_(0), scan_time_(0), inverted_(false), angle_min_(0),
+    angle_max_(0)
+{
+  pub_ = nh.advertise<sensor_msgs::PointCloud2>(topic, 10);
+}
+
+void CloudPublisher::configure(double scale, double scan_time, bool inverted, float angle_min,
+                               float angle_max, const std::string &frame_id)
+{
+  scale_ = scale;
+  scan_time_ = scan_time;
+  inverted_ = inverted;
+  angle_min_ = angle_min;
+  angle_max_ = angle_max;
+  frame_id_ = frame_id;
+  n_range_values_ = 0;
+}
+
+void CloudPublisher::publish(const uint32_t *range_values, uint32_t n_range_values,
+                             const ros::Time &start)
+{
+  if (pub_.getNumSubscribers() == 0 || n_range_values == 0)
+    return;
+  if (n_range_values != n_range_values_)
+    rebuild(n_range_values);
+
+  cloud_msg_.data.resize(n_range_values * ScanProjector::POINT_STEP);
+  uint32_t n_points = projector_.project(range_values, n_range_values, scale_, dense_,
+                                         (float *)&cloud_msg_.data[0]);
+  cloud_msg_.data.resize(n_points * ScanProjector::POINT_STEP);
+  cloud_msg_.header.stamp = start;
+  cloud_msg_.width = n_points;
+  cloud_msg_.row_step = n_points * ScanProjector::POINT_STEP;
+  pub_.publish(cloud_msg_);
+}
+
+void CloudPublisher::rebuild(uint32_t n_range_values)
+{
+  n_range_values_ = n_range_values;
+  // The same angles the LaserScan has, inverted or not
+  sensor_msgs::LaserScan scan_msg;
+  fill_scan_metadata(scan_msg, n_range_values, scale_, scan_time_, inverted_, angle_min_,
+                     angle_max_, frame_id_);
+  projector_.configure(n_range_values, scan_msg.angle_min, scan_msg.angle_increment);
+
+  cloud_msg_.header.frame_id = frame_id_;
+  cloud_msg_.height = 1;
+  cloud_msg_.fields.resize(3);
+  const char *names[] = { "x", "y", "z" };
+  for (size_t i = 0; i < cloud_msg_.fields.size(); i++) {
+    cloud_msg_.fields[i].name = names[i];
+    cloud_msg_.fields[i].offset = i * sizeof(float);
+    cloud_msg_.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+    cloud_msg_.fields[i].count = 1;
+  }
+  cloud_msg_.is_bigendian = false;
+  cloud_msg_.point_step = ScanProjector::POINT_STEP;
+  cloud_msg_.is_dense = dense_;
+  cloud_msg_.data.reserve(n_range_values * ScanProjector::POINT_STEP);
+}
+
+StatusPublisher::StatusPublisher(ros::NodeHandle &nh, const std::string &topic)
+{
+  pub_ = nh.advertise<sicktoolbox_pls_wrapper::ScanStatus>(topic, 10);
+}
+
+void StatusPublisher::configure(const std::string &frame_id)
+{
+  status_msg_.header.frame_id = frame_id;
+}
+
+void StatusPublisher::publish(const PlsScan &scan, const ros::Time &start)
+{
+  if (pub_.getNumSubscribers() == 0 || !scan.has(PlsScan::STATUS))
+    return;
+  status_msg_.header.stamp = start;
+  status_msg_.has_device_status = scan.has(PlsScan::DEVICE_STATUS);
+  status_msg_.device_status = scan.device_status;
+  status_msg_.status.assign(scan.status, scan.status + scan.size);
+  pub_.publish(status_msg_);
+}
+
+void publish_scan(diagnostic_updater::DiagnosedPublisher<sensor_msgs::LaserScan> *pub, const uint32_t *range_values,
+                  uint32_t n_range_values, double scale, ros::Time start,
+                  double scan_time, bool inverted, float angle_min,
+                  float angle_max, std::string frame_id, LaserScanPool *pool,
+                  PublishTiming *timing)
+{
+  uint64_t t0 = timing ? monotonic_ns() : 0;
+  if (pool) {
+    sensor_msgs::LaserScanPtr scan_msg = pool->acquire(n_range_values, start);
+    pool->fill(*scan_msg, range_values, n_range_values);
+    uint64_t t1 = timing ? monotonic_ns() : 0;
+    pub->publish(scan_msg);
+    if (timing) {
+      timing->convert_ns = t1 - t0;
+      timing->publish_ns = monotonic_ns() - t1;
+    }
+    return;
+  }
+
+  sensor_msgs::LaserScan scan_msg;
+  fill_scan_metadata(scan_msg, n_range_values, scale, scan_time, inverted,
+                     angle_min, angle_max, frame_id);
+  scan_msg.header.stamp = start;
+  fill_scan_ranges(scan_msg, range_values, n_range_values, scale);
+  uint64_t t1 = timing ? monotonic_ns() : 0;
+
+  pub->publish(scan_msg);
+  if (timing) {
+    timing->convert_ns = t1 - t0;
+    timing->publish_ns = monotonic_ns() - t1;
+  }
+}
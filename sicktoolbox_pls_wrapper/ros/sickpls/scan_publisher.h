@@ -0,0 +1,250 @@
+///////////////////////////////////////////////////////////////////////////////
+// turning raw PLS readings into LaserScan messages. Shared by the driver
+// and pls_replay so that both publish exactly the same way.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_SCAN_PUBLISHER_H
+#define SICKTOOLBOX_PLS_WRAPPER_SCAN_PUBLISHER_H
+
+#include <string>
+#include <vector>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "sensor_msgs/PointCloud2.h"
+#include <sicktoolbox_pls_wrapper/CompressedScan.h>
+#include <sicktoolbox_pls_wrapper/ScanStatus.h>
+#include <sicktoolbox_pls_wrapper/pls_scan.h>
+#include <sicktoolbox_pls_wrapper/range_conversion.h>
+#include <sicktoolbox_pls_wrapper/scan_projection.h>
+#include <diagnostic_updater/diagnostic_updater.h> // Publishing over the diagnostics channels.
+#include <diagnostic_updater/publisher.h>
+#include "param_snapshot.h"
+
+// Tick-tock transition variable, controls if the driver outputs NaNs and Infs
+extern bool use_rep_117_;
+
+// Sets use_rep_117_ from the use_rep_117 parameter, warning if it's off.
+// Only goes looking for it if it isn't in params.
+void load_use_rep_117(ros::NodeHandle &nh, const ParamSnapshot &params = ParamSnapshot());
+
+// The scan topic's frequency and timestamp diagnostic settings.
+struct ScanDiagnosticParams
+{
+  double desired_freq;
+  double min_freq;
+  double max_freq;
+  double freq_tolerance; // Tolerance before error, fractional percent of frequency.
+  int window_size; // Number of samples to consider in frequency
+  double min_delay; // The minimum publishing delay (in seconds) before error.  Negative values mean future dated messages.
+  double max_delay; // The maximum publishing delay (in seconds) before error.
+  std::string hardware_id;
+
+  void load(const ParamSnapshot &params, double default_freq);
+
+  // The returned parameter points at min_freq/max_freq, so this struct has
+  // to outlive the publisher built from it.
+  diagnostic_updater::FrequencyStatusParam frequencyStatusParam()
+  {
+    return diagnostic_updater::FrequencyStatusParam(&min_freq, &max_freq, freq_tolerance, window_size);
+  }
+  diagnostic_updater::TimeStampStatusParam timeStampStatusParam() const
+  {
+    return diagnostic_updater::TimeStampStatusParam(min_delay, max_delay);
+  }
+};
+
+// Fills in everything in a LaserScan that stays the same from one scan to
+// the next for a given laser configuration.
+void fill_scan_metadata(sensor_msgs::LaserScan &scan_msg, uint32_t n_range_values, double scale,
+                        double scan_time, bool inverted, float angle_min,
+                        float angle_max, const std::string &frame_id);
+
+// The conversion for scans at this scale under the current use_rep_117_,
+// for anything that converts every scan the same way to pick once.
+sicktoolbox_pls_wrapper::RangeConverter select_scan_converter(double scale);
+
+// Picks the conversion on every call; for one-off messages.
+void fill_scan_ranges(sensor_msgs::LaserScan &scan_msg, const uint32_t *range_values,
+                      uint32_t n_range_values, double scale);
+
+// The same for a CompressedScan; everything but the stamp, frame and data.
+void fill_compressed_metadata(sicktoolbox_pls_wrapper::CompressedScan &msg, uint32_t n_range_values,
+                              double scale, double scan_time, bool inverted, float angle_min,
+                              float angle_max, const std::string &frame_id);
+
+// Builds the LaserScan that a CompressedScan decoded to range_values stands
+// for.
+void fill_scan_from_compressed(sensor_msgs::LaserScan &scan_msg,
+                               const sicktoolbox_pls_wrapper::CompressedScan &msg,
+                               const uint32_t *range_values);
+
+// A handful of preallocated LaserScans that are published by shared_ptr and
+// reused once nobody (subscriber queue, intra-process subscriber, serializer)
+// holds a reference to them any more. Only the stamp, seq and ranges are
+// written per scan; everything else, down to which conversion the ranges
+// go through, is settled once by configure().
+class LaserScanPool
+{
+public:
+  explicit LaserScanPool(size_t size);
+
+  void configure(double scale, double scan_time, bool inverted, float angle_min,
+                 float angle_max, const std::string &frame_id);
+
+  // Returns a message ready for its ranges to be filled in.
+  sensor_msgs::LaserScanPtr acquire(uint32_t n_range_values, const ros::Time &start);
+
+  // Converts the ranges into a message from acquire().
+  void fill(sensor_msgs::LaserScan &scan_msg, const uint32_t *range_values, uint32_t n_range_values) const
+  {
+    converter_(range_values, &scan_msg.ranges[0], n_range_values, (float)scale_);
+  }
+
+private:
+  void rebuild(uint32_t n_range_values);
+
+  sicktoolbox_pls_wrapper::RangeConverter converter_;
+  std::vector<sensor_msgs::LaserScanPtr> pool_;
+  size_t next_;
+  uint32_t seq_;
+  unsigned long misses_;
+  uint32_t n_range_values_;
+  double scale_;
+  double scan_time_;
+  bool inverted_;
+  float angle_min_;
+  float angle_max_;
+  std::string frame_id_;
+};
+
+// How one decimated topic thins the scans out.
+struct DecimatedTopicConfig
+{
+  std::string topic;
+  int every; // publish every Nth scan
+  int bins; // and every Mth reading of it,
+  bool min_pooling; // or the nearest of the M readings around it
+};
+
+// A lower-rate, lower-resolution copy of the scan topic for consumers that
+// don't need all of it, built straight from the raw readings. Costs nothing
+// while nobody is subscribed.
+class DecimatedScanPublisher
+{
+public:
+  DecimatedScanPublisher(ros::NodeHandle &nh, const DecimatedTopicConfig &config);
+
+  void configure(double scale, double scan_time, bool inverted, float angle_min,
+                 float angle_max, const std::string &frame_id);
+
+  // Call with every scan; publishes the ones that are due.
+  void publish(const uint32_t *range_values, uint32_t n_range_values, const ros::Time &start);
+
+private:
+  void rebuild(uint32_t n_range_values);
+
+  DecimatedTopicConfig config_;
+  sicktoolbox_pls_wrapper::RangeConverter converter_;
+  ros::Publisher pub_;
+  unsigned long scans_;
+  sensor_msgs::LaserScan scan_msg_;
+  std::vector<uint32_t> range_values_;
+  uint32_t n_range_values_;
+  double scale_;
+  double scan_time_;
+  bool inverted_;
+  float angle_min_;
+  float angle_max_;
+  std::string frame_id_;
+};
+
+// The scan as a PointCloud2 of x, y, z points in the laser's frame,
+// projected straight from the raw readings so that nobody downstream has to
+// run laser_geometry on it. Out-of-range readings are left out of a dense
+// cloud and are NaN points otherwise. Costs nothing while nobody is
+// subscribed.
+class CloudPublisher
+{
+public:
+  CloudPublisher(ros::NodeHandle &nh, const std::string &topic, bool dense);
+
+  void configure(double scale, double scan_time, bool inverted, float angle_min,
+                 float angle_max, const std::string &frame_id);
+
+  void publish(const uint32_t *range_values, uint32_t n_range_values, const ros::Time &start);
+
+private:
+  void rebuild(uint32_t n_range_values);
+
+  ros::Publisher pub_;
+  bool dense_;
+  sicktoolbox_pls_wrapper::ScanProjector projector_;
+  sensor_msgs::PointCloud2 cloud_msg_;
+  uint32_t n_range_values_;
+  double scale_;
+  double scan_time_;
+  bool inverted_;
+  float angle_min_;
+  float angle_max_;
+  std::string frame_id_;
+};
+
+// Each reading's status bits alongside the scan, stamped the same, for
+// consumers that want to mask out bad readings. Costs nothing while nobody
+// is subscribed.
+class StatusPublisher
+{
+public:
+  StatusPublisher(ros::NodeHandle &nh, const std::string &topic);
+
+  void configure(const std::string &frame_id);
+
+  void publish(const sicktoolbox_pls_wrapper::PlsScan &scan, const ros::Time &start);
+
+private:
+  ros::Publisher pub_;
+  sicktoolbox_pls_wrapper::ScanStatus status_msg_;
+};
+
+// Where publish_scan spent its time, on the monotonic clock.
+struct PublishTiming
+{
+  uint64_t convert_ns; // building the message
+  uint64_t publish_ns; // handing it to the publisher
+};
+
+void publish_scan(diagnostic_updater::DiagnosedPublisher<sensor_msgs::LaserScan> *pub, const uint32_t *range_values,
+                  uint32_t n_range_values, double scale, ros::Time start,
+                  double scan_time, bool inverted, float angle_min,
+                  float angle_max, std::string frame_id, LaserScanPool *pool = NULL,
+                  PublishTiming *timing = NULL);
+
+#endif
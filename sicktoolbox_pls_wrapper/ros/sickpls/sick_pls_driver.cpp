@@ -0,0 +1,250 @@
+///////////////////////////////////////////////////////////////////////////////
+// the whole driver: every laser configured under ~, opened and published
+// until shutdown, for the sick_pls_wrapper node and nodelet alike.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include "sick_pls_driver.h"
+using namespace SickToolbox;
+
+// Opens one laser, on a thread of its own while the driver sets up ROS.
+struct DeviceOpener
+{
+  enum Result { OPENED, UNUSABLE, FAILED };
+
+  explicit DeviceOpener(PlsDevice *device) : device(device), result(FAILED) {}
+
+  void operator()()
+  {
+    try {
+      result = device->open() ? OPENED : UNUSABLE;
+    }
+    catch (...) {
+      result = FAILED;
+    }
+  }
+
+  PlsDevice *device;
+  Result result;
+};
+
+SickPlsDriver::SickPlsDriver(const ros::NodeHandle &nh, const ros::NodeHandle &private_nh)
+  : nh_(nh), private_nh_(private_nh), spin_callbacks_(false), default_message_pool_size_(0),
+    stopping_(false), multi_(false)
+{
+}
+
+int SickPlsDriver::initialize()
+{
+  // Every parameter under ~ in one round trip to the master
+  ParamSnapshot params(private_nh_);
+
+  // Check whether or not to support REP 117
+  load_use_rep_117(nh_, params);
+
+  std::vector<std::string> names;
+  XmlRpc::XmlRpcValue devices_param;
+  if (params.getParam("devices", devices_param)) {
+    if (devices_param.getType() != XmlRpc::XmlRpcValue::TypeArray || devices_param.size() == 0) {
+      ROS_ERROR("~devices must be a non-empty list of laser names");
+      return 1;
+    }
+    for (int i = 0; i < devices_param.size(); i++)
+      names.push_back(static_cast<std::string>(devices_param[i]));
+  }
+
+  // Every scan as a datagram, for consumers that don't run ROS
+  std::string udp_destination, udp_interface;
+  params.param<std::string>("udp_destination", udp_destination, "");
+  if (!udp_destination.empty()) {
+    params.param<std::string>("udp_interface", udp_interface, "");
+    int ttl;
+    bool loopback;
+    params.param("udp_ttl", ttl, 1);
+    params.param("udp_loopback", loopback, true);
+    udp_.reset(new sicktoolbox_pls_wrapper::PlsUdpSender);
+    if (!udp_->open(udp_destination, udp_interface, ttl, loopback, std::max<size_t>(names.size(), 16))) {
+      ROS_WARN("Not sending scans over UDP: %s", udp_->error().c_str());
+      udp_.reset();
+    }
+  }
+
+  multi_ = !names.empty();
+  if (!multi_)
+    names.push_back("");
+  for (size_t i = 0; i < names.size(); i++) {
+    ParamSnapshot device_params = multi_ ? params.child(names[i]) : params;
+    PlsDeviceConfig config;
+    config.name = names[i];
+    config.load(device_params);
+    if (!device_params.hasParam("message_pool_size"))
+      config.message_pool_size = default_message_pool_size_;
+    if (!device_params.hasParam("udp_sensor_id"))
+      config.udp_sensor_id = i;
+    // One thread publishes for all of them, so none of them can block it
+    if (multi_)
+      config.acquisition_thread = true;
+    if (SickPLS::IntToSickBaud(config.baud) == SickPLS::SICK_BAUD_UNKNOWN) {
+      ROS_ERROR("Baud rate must be in {9600, 19200, 38400, 500000}");
+      return 1;
+    }
+    devices_.push_back(boost::shared_ptr<PlsDevice>(new PlsDevice(config, device_params)));
+    devices_.back()->setUdpSender(udp_.get());
+  }
+
+  // Probing a laser's baud rate takes seconds and advertising takes a
+  // round trip to the master per topic; do them at the same time.
+  std::vector<DeviceOpener> openers;
+  for (size_t i = 0; i < devices_.size(); i++)
+    openers.push_back(DeviceOpener(devices_[i].get()));
+  boost::thread_group opening;
+  for (size_t i = 0; i < openers.size(); i++)
+    opening.create_thread(boost::ref(openers[i]));
+  for (size_t i = 0; i < devices_.size(); i++)
+    devices_[i]->advertise(nh_);
+  opening.join_all();
+
+  for (size_t i = 0; i < openers.size(); i++) {
+    if (openers[i].result == DeviceOpener::FAILED) {
+      ROS_ERROR("Initialize failed! are you using the correct device path?");
+      return 2;
+    }
+    if (openers[i].result == DeviceOpener::UNUSABLE)
+      return 1;
+  }
+  for (size_t i = 0; i < devices_.size(); i++)
+    devices_[i]->setup();
+  return 0;
+}
+
+void SickPlsDriver::spinOnce()
+{
+  // Whatever this pass published, in one go
+  if (udp_)
+    udp_->flush();
+  if (spin_callbacks_)
+    ros::spinOnce();
+  // Update diagnostics
+  for (size_t i = 0; i < devices_.size(); i++)
+    devices_[i]->updateDiagnostics();
+}
+
+int SickPlsDriver::spin()
+{
+  try {
+    if (multi_)
+      return spinDevices();
+
+    PlsDevice &device = *devices_[0];
+    if (device.config().acquisition_thread) {
+      device.start();
+      while (running() && !device.failed()) {
+        device.waitAndPublish(100);
+        spinOnce();
+      }
+      device.stop();
+      if (device.failed())
+        return 1;
+    }
+    else {
+      while (running()) {
+        device.readAndPublish();
+        spinOnce();
+      }
+    }
+  }
+  catch (...) {
+    ROS_ERROR("Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+// Drives every laser from this one thread. Each laser is read on its own
+// acquisition thread; those signal an eventfd per laser, which is what we
+// wait on here.
+int SickPlsDriver::spinDevices()
+{
+  int epoll_fd = epoll_create(devices_.size());
+  if (epoll_fd < 0) {
+    ROS_ERROR("epoll_create failed: %s", strerror(errno));
+    return 1;
+  }
+  for (size_t i = 0; i < devices_.size(); i++) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = i;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, devices_[i]->eventFd(), &event) < 0) {
+      ROS_ERROR("epoll_ctl failed: %s", strerror(errno));
+      close(epoll_fd);
+      return 1;
+    }
+  }
+
+  int ret = 0;
+  for (size_t i = 0; i < devices_.size(); i++)
+    devices_[i]->start();
+  std::vector<struct epoll_event> events(devices_.size());
+  while (running() && ret == 0) {
+    int n = epoll_wait(epoll_fd, &events[0], events.size(), 100);
+    if (n < 0 && errno != EINTR) {
+      ROS_ERROR("epoll_wait failed: %s", strerror(errno));
+      ret = 1;
+    }
+    for (int i = 0; i < n; i++)
+      devices_[events[i].data.u32]->drain();
+    for (size_t i = 0; i < devices_.size(); i++) {
+      if (devices_[i]->failed()) {
+        ROS_ERROR("Lost laser %s.", devices_[i]->config().name.c_str());
+        ret = 1;
+      }
+    }
+    spinOnce();
+  }
+  for (size_t i = 0; i < devices_.size(); i++)
+    devices_[i]->stop();
+  close(epoll_fd);
+  return ret;
+}
+
+int SickPlsDriver::uninitialize()
+{
+  try {
+    for (size_t i = 0; i < devices_.size(); i++)
+      devices_[i]->uninitialize();
+  }
+  catch (...) {
+    ROS_ERROR("Error during uninitialize");
+    return 1;
+  }
+  return 0;
+}
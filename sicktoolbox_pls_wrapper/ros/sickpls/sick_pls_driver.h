@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// the whole driver: every laser configured under ~, opened and published
+// until shutdown, for the sick_pls_wrapper node and nodelet alike.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_SICK_PLS_DRIVER_H
+#define SICKTOOLBOX_PLS_WRAPPER_SICK_PLS_DRIVER_H
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include "ros/ros.h"
+#include "pls_device.h"
+
+// What main() used to be. The lasers are read and published from whichever
+// thread calls spin(); the node calls it from main, the nodelet from a
+// thread of its own.
+class SickPlsDriver : boost::noncopyable
+{
+public:
+  // Topics are advertised on nh and parameters read from private_nh.
+  SickPlsDriver(const ros::NodeHandle &nh, const ros::NodeHandle &private_nh);
+
+  // Call ros::spinOnce() between scans: for the node, whose callbacks are
+  // on the global queue. A nodelet manager runs its nodelets' callbacks.
+  void setSpinCallbacks(bool spin) { spin_callbacks_ = spin; }
+  // What ~message_pool_size is when it isn't set. Only a message published
+  // by shared_ptr reaches an in-process subscriber without a copy.
+  void setDefaultMessagePoolSize(int size) { default_message_pool_size_ = size; }
+
+  // Loads the parameters and opens every laser. Returns 0, or the exit
+  // code to give up with.
+  int initialize();
+  // Publishes until ROS shuts down or stop() is called. Returns the exit
+  // code; nonzero means a laser was lost.
+  int spin();
+  // Makes spin() return soon; from any thread.
+  void stop() { stopping_ = true; }
+  int uninitialize();
+
+private:
+  bool running() const { return ros::ok() && !stopping_; }
+  void spinOnce();
+  int spinDevices();
+
+  ros::NodeHandle nh_;
+  ros::NodeHandle private_nh_;
+  bool spin_callbacks_;
+  int default_message_pool_size_;
+  volatile bool stopping_;
+  // With ~devices set, every name in it is a laser configured under
+  // ~<name>/; otherwise there's one configured directly under ~.
+  bool multi_;
+  std::vector<boost::shared_ptr<PlsDevice> > devices_;
+  // With ~udp_destination, shared by all the lasers so that a pass over
+  // them goes out in one sendmmsg
+  boost::scoped_ptr<sicktoolbox_pls_wrapper::PlsUdpSender> udp_;
+};
+
+#endif
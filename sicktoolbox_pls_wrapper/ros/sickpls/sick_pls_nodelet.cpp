@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// sick_pls_wrapper as a nodelet, so that subscribers in the same manager
+// get scans without them being serialized.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include "sick_pls_driver.h"
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Takes the same parameters as the node, in the nodelet's private
+// namespace. Scans are read and published on a thread of the nodelet's own
+// so the manager's threads never block on a laser.
+class SickPlsNodelet : public nodelet::Nodelet
+{
+public:
+  SickPlsNodelet() {}
+
+  ~SickPlsNodelet()
+  {
+    if (driver_) {
+      driver_->stop();
+      thread_.join();
+    }
+  }
+
+private:
+  virtual void onInit()
+  {
+    driver_.reset(new SickPlsDriver(getNodeHandle(), getPrivateNodeHandle()));
+    // Without a pool every scan is published by value, and a subscriber in
+    // the same process gets a copy that went through serialization.
+    driver_->setDefaultMessagePoolSize(8);
+    thread_ = boost::thread(boost::bind(&SickPlsNodelet::run, this));
+  }
+
+  void run()
+  {
+    // Opening a laser takes seconds; onInit can't.
+    int ret = driver_->initialize();
+    if (ret == 0)
+      ret = driver_->spin();
+    if (ret == 0)
+      ret = driver_->uninitialize();
+    if (ret != 0)
+      NODELET_ERROR("sick_pls_wrapper nodelet stopped (%d)", ret);
+  }
+
+  boost::scoped_ptr<SickPlsDriver> driver_;
+  boost::thread thread_;
+};
+
+} // namespace sicktoolbox_pls_wrapper
+
+PLUGINLIB_DECLARE_CLASS(sicktoolbox_pls_wrapper, SickPlsNodelet, sicktoolbox_pls_wrapper::SickPlsNodelet,
+                        nodelet::Nodelet)
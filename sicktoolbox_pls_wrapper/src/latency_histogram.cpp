@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// fixed-size log-linear histograms for timing the driver loop.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <cstring>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+void LatencyHistogram::reset()
+{
+  memset(counts_, 0, sizeof(counts_));
+  count_ = 0;
+  min_ = 0;
+  max_ = 0;
+  sum_ = 0;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(unsigned index)
+{
+  if (index < SUB_BUCKETS)
+    return index;
+  unsigned shift = index / HALF_SUB_BUCKETS - 1;
+  uint64_t sub_bucket = index % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::valueAtPercentile(double percentile) const
+{
+  if (count_ == 0)
+    return 0;
+  uint64_t target = (uint64_t)(percentile / 100.0 * count_ + 0.5);
+  if (target < 1)
+    target = 1;
+  if (target > count_)
+    target = count_;
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < BUCKETS; i++) {
+    seen += counts_[i];
+    if (seen >= target) {
+      uint64_t value = bucketUpperBound(i);
+      return value < max_ ? value : max_;
+    }
+  }
+  return max_;
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,140 @@
+///////////////////////////////////////////////////////////////////////////////
+// getting a PLS back to a known baud rate quickly.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/pls_baud.h>
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <sicktoolbox_pls_wrapper/pls_serial.h>
+#include <sicktoolbox_pls_wrapper/pls_telegram.h>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+BaudCache::BaudCache(const std::string &dir, const std::string &device)
+{
+  if (dir.empty())
+    return;
+  // /dev/ttyUSB0 -> <dir>/pls_dev_ttyUSB0.baud
+  std::string name = device;
+  for (size_t i = 0; i < name.size(); i++)
+    if (name[i] == '/')
+      name[i] = '_';
+  size_t start = name.find_first_not_of('_');
+  path_ = dir + "/pls_" + (start == std::string::npos ? name : name.substr(start)) + ".baud";
+}
+
+uint32_t BaudCache::load() const
+{
+  if (path_.empty())
+    return 0;
+  FILE *f = fopen(path_.c_str(), "r");
+  if (!f)
+    return 0;
+  unsigned long baud = 0;
+  if (fscanf(f, "%lu", &baud) != 1 || !pls_baud_mode(baud))
+    baud = 0;
+  fclose(f);
+  return baud;
+}
+
+bool BaudCache::store(uint32_t baud) const
+{
+  if (path_.empty())
+    return false;
+  // Write then rename, so a crash never leaves half a number behind.
+  std::string tmp = path_ + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (!f)
+    return false;
+  bool ok = fprintf(f, "%u\n", baud) > 0;
+  ok = fclose(f) == 0 && ok;
+  return ok && rename(tmp.c_str(), path_.c_str()) == 0;
+}
+
+bool pls_reset_session_baud(const std::string &device, uint32_t baud, double timeout)
+{
+  std::string error;
+  int fd = pls_open_serial(device, baud, &error);
+  if (fd < 0)
+    return false;
+
+  uint8_t payload[2] = { PLS_CMD_SWITCH_MODE, pls_baud_mode(9600) };
+  uint8_t telegram[2 + PLS_TELEGRAM_OVERHEAD];
+  size_t length = pls_build_telegram(payload, sizeof(payload), telegram);
+  if (!pls_write_serial(fd, telegram, length)) {
+    close(fd);
+    return false;
+  }
+
+  // Look for the ACK, then for a response telegram saying the switch worked.
+  uint8_t response[32];
+  size_t have = 0;
+  bool acked = false;
+  bool ok = false;
+  uint64_t deadline = monotonic_ns() + (uint64_t)(timeout * 1e9);
+  while (!ok) {
+    uint64_t now = monotonic_ns();
+    if (now >= deadline)
+      break;
+    uint8_t byte;
+    ssize_t n = pls_read_serial(fd, &byte, 1, (deadline - now) * 1e-9);
+    if (n < 0)
+      break;
+    if (n == 0)
+      continue;
+    if (!acked) {
+      if (byte == PLS_NACK)
+        break;
+      acked = byte == PLS_ACK;
+      continue;
+    }
+    if (have == 0 && byte != PLS_STX)
+      continue;
+    response[have++] = byte;
+    if (have >= 4) {
+      size_t payload_length = response[2] | (response[3] << 8);
+      size_t total = payload_length + PLS_TELEGRAM_OVERHEAD;
+      if (payload_length < 2 || total > sizeof(response)) {
+        have = 0;  // not the telegram we're after; resync on the next STX
+        continue;
+      }
+      if (have == total) {
+        uint16_t crc = response[total - 2] | (response[total - 1] << 8);
+        ok = crc == pls_crc16(response, total - 2) &&
+             response[4] == (PLS_CMD_SWITCH_MODE | PLS_RESPONSE_OFFSET) && response[5] == 0x00;
+        have = 0;
+      }
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,359 @@
+///////////////////////////////////////////////////////////////////////////////
+// reading and writing binary PLS scan logs.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/pls_log.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace sicktoolbox_pls_wrapper
+{
+
+bool pls_log_lz4_supported()
+{
+#ifdef HAVE_LZ4
+  return true;
+#else
+  return false;
+#endif
+}
+
+size_t pls_log_record_size(uint32_t ranges_per_record, uint32_t flags)
+{
+  size_t size = sizeof(PlsLogRecord) + ranges_per_record * sizeof(uint16_t);
+  if (flags & PLS_LOG_STATUS)
+    size += ranges_per_record;
+  return (size + 7) & ~(size_t)7;
+}
+
+PlsLogWriter::PlsLogWriter()
+  : fd_(-1), end_(0), batch_size_(0), pending_(0)
+{
+  memset(&header_, 0, sizeof(header_));
+}
+
+PlsLogWriter::~PlsLogWriter()
+{
+  close();
+}
+
+bool PlsLogWriter::fail(const std::string &what)
+{
+  error_ = what + ": " + strerror(errno);
+  return false;
+}
+
+bool PlsLogWriter::open(const std::string &path, const std::string &device, uint32_t baud,
+                        uint32_t units, uint32_t ranges_per_record, size_t batch_size,
+                        bool compress, bool status)
+{
+  close();
+  if (compress && !pls_log_lz4_supported()) {
+    error_ = "this build has no LZ4 support";
+    return false;
+  }
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0)
+    return fail("couldn't open " + path);
+
+  memset(&header_, 0, sizeof(header_));
+  memcpy(header_.magic, PLS_LOG_MAGIC, sizeof(header_.magic));
+  header_.version = PLS_LOG_VERSION;
+  header_.header_size = sizeof(PlsLogHeader);
+  header_.flags = (compress ? PLS_LOG_LZ4 : 0) | (status ? PLS_LOG_STATUS : 0);
+  header_.ranges_per_record = ranges_per_record;
+  header_.record_size = ranges_per_record ? pls_log_record_size(ranges_per_record, header_.flags) : 0;
+  header_.baud = baud;
+  header_.units = units;
+  strncpy(header_.device, device.c_str(), sizeof(header_.device) - 1);
+  batch_size_ = batch_size ? batch_size : 1;
+  pending_ = 0;
+  end_ = header_.header_size;
+  return writeHeader();
+}
+
+bool PlsLogWriter::writeHeader()
+{
+  if (pwrite(fd_, &header_, sizeof(header_), 0) != (ssize_t)sizeof(header_))
+    return fail("couldn't write log header");
+  return true;
+}
+
+PlsLogRecord *PlsLogWriter::addRecord(uint64_t stamp_ns, const uint32_t *range_values,
+                                      uint32_t n_range_values)
+{
+  if (fd_ < 0)
+    return NULL;
+  if (header_.record_size == 0) {
+    header_.ranges_per_record = n_range_values;
+    header_.record_size = pls_log_record_size(n_range_values, header_.flags);
+  }
+  if (batch_.size() != batch_size_ * header_.record_size)
+    batch_.assign(batch_size_ * header_.record_size, 0);
+
+  PlsLogRecord *record = reinterpret_cast<PlsLogRecord *>(&batch_[pending_ * header_.record_size]);
+  uint32_t n = n_range_values < header_.ranges_per_record ? n_range_values : header_.ranges_per_record;
+  record->stamp_ns = stamp_ns;
+  record->num_ranges = n;
+  record->device_status = 0;
+  record->flags = 0;
+  record->reserved = 0;
+  uint16_t *ranges = record->ranges();
+  for (uint32_t i = 0; i < n; i++)
+    ranges[i] = range_values[i] > 0xffff ? 0xffff : range_values[i];
+  for (uint32_t i = n; i < header_.ranges_per_record; i++)
+    ranges[i] = 0;
+  if (header_.flags & PLS_LOG_STATUS)
+    memset(record->status(header_.ranges_per_record), 0, header_.ranges_per_record);
+  return record;
+}
+
+bool PlsLogWriter::commitRecord()
+{
+  if (++pending_ == batch_size_)
+    return flush();
+  return true;
+}
+
+bool PlsLogWriter::append(uint64_t stamp_ns, const uint32_t *range_values, uint32_t n_range_values)
+{
+  if (!addRecord(stamp_ns, range_values, n_range_values))
+    return false;
+  return commitRecord();
+}
+
+bool PlsLogWriter::append(const PlsScan &scan)
+{
+  PlsLogRecord *record = addRecord(scan.host_stamp_ns, scan.ranges, scan.size);
+  if (!record)
+    return false;
+  if (header_.flags & PLS_LOG_STATUS) {
+    if (scan.has(PlsScan::STATUS)) {
+      memcpy(record->status(header_.ranges_per_record), scan.status, record->num_ranges);
+      record->flags |= PLS_RECORD_STATUS;
+    }
+    if (scan.has(PlsScan::DEVICE_STATUS)) {
+      record->device_status = scan.device_status;
+      record->flags |= PLS_RECORD_DEVICE_STATUS;
+    }
+  }
+  return commitRecord();
+}
+
+bool PlsLogWriter::flush()
+{
+  if (fd_ < 0)
+    return false;
+  if (pending_ == 0)
+    return writeHeader();
+  size_t length = pending_ * header_.record_size;
+  if (header_.flags & PLS_LOG_LZ4) {
+#ifdef HAVE_LZ4
+    compressed_.resize(sizeof(PlsLogBlock) + LZ4_compressBound(length) + 8);
+    PlsLogBlock *block = reinterpret_cast<PlsLogBlock *>(&compressed_[0]);
+    int size = LZ4_compress_default(&batch_[0], &compressed_[sizeof(PlsLogBlock)], length,
+                                    compressed_.size() - sizeof(PlsLogBlock) - 8);
+    if (size <= 0) {
+      error_ = "couldn't compress log records";
+      return false;
+    }
+    block->raw_size = length;
+    block->compressed_size = size;
+    block->scan_count = pending_;
+    block->reserved = 0;
+    length = (sizeof(PlsLogBlock) + size + 7) & ~(size_t)7;
+    memset(&compressed_[sizeof(PlsLogBlock) + size], 0, length - sizeof(PlsLogBlock) - size);
+    if (!writeAll(&compressed_[0], length, end_))
+      return false;
+#endif
+  }
+  else if (!writeAll(&batch_[0], length, end_)) {
+    return false;
+  }
+  end_ += length;
+  header_.scan_count += pending_;
+  pending_ = 0;
+  return writeHeader();
+}
+
+bool PlsLogWriter::writeAll(const char *p, size_t length, off_t offset)
+{
+  while (length > 0) {
+    ssize_t n = pwrite(fd_, p, length, offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return fail("couldn't write log records");
+    }
+    p += n;
+    offset += n;
+    length -= n;
+  }
+  return true;
+}
+
+bool PlsLogWriter::sync()
+{
+  if (fd_ < 0)
+    return false;
+  if (fdatasync(fd_) < 0)
+    return fail("couldn't sync log");
+  return true;
+}
+
+bool PlsLogWriter::close()
+{
+  if (fd_ < 0)
+    return true;
+  bool ok = flush();
+  if (::close(fd_) < 0 && ok)
+    ok = fail("couldn't close log");
+  fd_ = -1;
+  return ok;
+}
+
+PlsLogReader::PlsLogReader()
+  : data_(NULL), length_(0), mapped_(false), header_(NULL), size_(0)
+{
+}
+
+PlsLogReader::~PlsLogReader()
+{
+  close();
+}
+
+bool PlsLogReader::fail(const std::string &what)
+{
+  error_ = what;
+  close();
+  return false;
+}
+
+bool PlsLogReader::open(const std::string &path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return fail("couldn't open " + path + ": " + strerror(errno));
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(PlsLogHeader)) {
+    ::close(fd);
+    return fail(path + " is too short to be a PLS log");
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    return fail("couldn't mmap " + path + ": " + strerror(errno));
+  data_ = static_cast<const char *>(map);
+  length_ = st.st_size;
+  mapped_ = true;
+  header_ = reinterpret_cast<const PlsLogHeader *>(data_);
+
+  if (memcmp(header_->magic, PLS_LOG_MAGIC, sizeof(header_->magic)) != 0)
+    return fail(path + " is not a binary PLS log");
+  if (header_->version < 1 || header_->version > PLS_LOG_VERSION)
+    return fail(path + " has an unsupported log version");
+  if (header_->header_size < sizeof(PlsLogHeader) || header_->header_size > length_)
+    return fail(path + " has a corrupt header");
+  if (header_->record_size == 0) {
+    size_ = 0; // nothing was ever logged
+    return true;
+  }
+  if (header_->flags & ~(PLS_LOG_LZ4 | PLS_LOG_STATUS))
+    return fail(path + " uses log features this reader doesn't know about");
+  if (header_->record_size < pls_log_record_size(header_->ranges_per_record, header_->flags))
+    return fail(path + " has a corrupt header");
+  if (header_->flags & PLS_LOG_LZ4) {
+    if (!pls_log_lz4_supported())
+      return fail(path + " is compressed and this build has no LZ4 support");
+    inflate();
+    return true;
+  }
+  size_ = (length_ - header_->header_size) / header_->record_size;
+  // Sequential scans through a log are the common case.
+  madvise(const_cast<char *>(data_), length_, MADV_SEQUENTIAL);
+  return true;
+}
+
+// Replaces the mapping with the log as it would have been written plain.
+// A block cut off by a crash ends the log, as a partial record would.
+void PlsLogReader::inflate()
+{
+#ifdef HAVE_LZ4
+  size_t record_size = header_->record_size;
+  std::vector<char> inflated(data_, data_ + header_->header_size);
+  inflated.reserve(header_->header_size + header_->scan_count * record_size);
+  size_t offset = header_->header_size;
+  uint64_t scans = 0;
+  while (offset + sizeof(PlsLogBlock) <= length_) {
+    PlsLogBlock block;
+    memcpy(&block, data_ + offset, sizeof(block));
+    size_t end = offset + sizeof(PlsLogBlock) + block.compressed_size;
+    if (block.compressed_size == 0 || end > length_ ||
+        block.raw_size != block.scan_count * record_size)
+      break;
+    size_t at = inflated.size();
+    inflated.resize(at + block.raw_size);
+    int n = LZ4_decompress_safe(data_ + offset + sizeof(PlsLogBlock), &inflated[at],
+                                block.compressed_size, block.raw_size);
+    if (n != (int)block.raw_size) {
+      inflated.resize(at);
+      break;
+    }
+    scans += block.scan_count;
+    offset = (end + 7) & ~(size_t)7;
+  }
+  munmap(const_cast<char *>(data_), length_);
+  mapped_ = false;
+  inflated_.swap(inflated);
+  data_ = &inflated_[0];
+  length_ = inflated_.size();
+  header_ = reinterpret_cast<const PlsLogHeader *>(data_);
+  size_ = scans;
+#endif
+}
+
+void PlsLogReader::close()
+{
+  if (data_ && mapped_)
+    munmap(const_cast<char *>(data_), length_);
+  inflated_.clear();
+  mapped_ = false;
+  data_ = NULL;
+  length_ = 0;
+  header_ = NULL;
+  size_ = 0;
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////////
+// the background scan log writer.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/pls_log_async.h>
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+AsyncLogWriter::AsyncLogWriter()
+  : baud_(0), units_(0), event_fd_(-1), running_(false), failed_(false), written_(0), dropped_(0),
+    files_(0), syncs_(0), ascii_(NULL), ascii_bytes_(0), opened_ns_(0), synced_ns_(0)
+{
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+  close();
+}
+
+bool AsyncLogWriter::fail(const std::string &what)
+{
+  boost::mutex::scoped_lock lock(error_mutex_);
+  error_ = what;
+  failed_ = true;
+  return false;
+}
+
+std::string AsyncLogWriter::error() const
+{
+  boost::mutex::scoped_lock lock(error_mutex_);
+  return error_;
+}
+
+bool AsyncLogWriter::open(const std::string &path, const std::string &device, uint32_t baud,
+                          uint32_t units, const AsyncLogOptions &options)
+{
+  close();
+  if (options.ascii && options.compress)
+    return fail("ASCII logs can't be compressed");
+  if (options.compress && !pls_log_lz4_supported())
+    return fail("this build has no LZ4 support");
+  options_ = options;
+  path_ = path;
+  device_ = device;
+  baud_ = baud;
+  units_ = units;
+  written_ = dropped_ = files_ = syncs_ = 0;
+  failed_ = false;
+  error_.clear();
+
+  ring_.reset(new ScanRing<PlsScan *>(options.queue_size ? options.queue_size : 1, DROP_NEWEST));
+  // The queue and the one scan being written
+  pool_.reset(new PlsScanPool(ring_->capacity() + 1));
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd_ < 0)
+    return fail(std::string("couldn't create the log queue eventfd: ") + strerror(errno));
+  if (!openFile())
+    return false;
+  running_ = true;
+  thread_ = boost::thread(&AsyncLogWriter::run, this);
+  return true;
+}
+
+bool AsyncLogWriter::append(const PlsScan &scan)
+{
+  if (!running_)
+    return false;
+  PlsScan *copy = pool_->acquire();
+  if (!copy) {
+    ++dropped_;
+    return false;
+  }
+  copy->assign(scan);
+  PlsScan *lost = NULL;
+  if (ring_->push(copy, lost)) {
+    pool_->release(lost);
+    ++dropped_;
+    return false;
+  }
+  signal();
+  return true;
+}
+
+bool AsyncLogWriter::close()
+{
+  if (running_) {
+    running_ = false;
+    signal();
+    thread_.join();
+  }
+  bool ok = closeFile() && !failed_;
+  if (event_fd_ >= 0)
+    ::close(event_fd_);
+  event_fd_ = -1;
+  return ok;
+}
+
+void AsyncLogWriter::signal()
+{
+  uint64_t one = 1;
+  if (::write(event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    fail(std::string("couldn't signal the log queue: ") + strerror(errno));
+}
+
+void AsyncLogWriter::run()
+{
+  for (;;) {
+    // Look before draining, so nothing queued before close is left behind.
+    bool stopping = !running_;
+    PlsScan *scan;
+    while (ring_->pop(scan)) {
+      // After a failure keep emptying the queue; the caller sees failed().
+      if (!failed_)
+        writeScan(*scan);
+      pool_->release(scan);
+    }
+    if (!failed_)
+      maintain(monotonic_ns());
+    if (stopping)
+      return;
+
+    // Wake up now and again even with nothing queued, for rotating and
+    // syncing on time.
+    struct pollfd pfd;
+    pfd.fd = event_fd_;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 100) > 0) {
+      uint64_t count;
+      if (::read(event_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        fail(std::string("couldn't read the log queue eventfd: ") + strerror(errno));
+    }
+  }
+}
+
+bool AsyncLogWriter::writeScan(const PlsScan &scan)
+{
+  if (options_.rotate_bytes && fileBytes() >= options_.rotate_bytes &&
+      !(closeFile() && openFile()))
+    return false;
+  if (options_.ascii) {
+    int n = fprintf(ascii_, "%.6f", scan.host_stamp_ns * 1e-9);
+    for (uint32_t i = 0; i < scan.size && n >= 0; i++) {
+      int m = fprintf(ascii_, " %u", scan.ranges[i]);
+      n = m < 0 ? m : n + m;
+    }
+    if (n < 0 || fputc('\n', ascii_) == EOF)
+      return fail(std::string("couldn't write log: ") + strerror(errno));
+    ascii_bytes_ += n + 1;
+  }
+  else {
+    binary_.setUnits(units_);
+    if (!binary_.append(scan))
+      return fail(binary_.error());
+  }
+  ++written_;
+  return true;
+}
+
+// Time-based rotation and syncing.
+bool AsyncLogWriter::maintain(uint64_t now_ns)
+{
+  if (options_.rotate_seconds > 0 && now_ns - opened_ns_ >= options_.rotate_seconds * 1e9)
+    return closeFile() && openFile();
+  if (options_.sync_seconds > 0 && now_ns - synced_ns_ >= options_.sync_seconds * 1e9)
+    return syncFile();
+  return true;
+}
+
+uint64_t AsyncLogWriter::fileBytes() const
+{
+  return options_.ascii ? ascii_bytes_ : binary_.bytes();
+}
+
+std::string AsyncLogWriter::nextPath() const
+{
+  if (!options_.rotate_bytes && options_.rotate_seconds <= 0)
+    return path_;
+  std::string stem = path_;
+  std::string extension;
+  size_t dot = path_.rfind('.');
+  size_t slash = path_.rfind('/');
+  if (dot != std::string::npos && dot > 0 && (slash == std::string::npos || dot > slash + 1)) {
+    stem = path_.substr(0, dot);
+    extension = path_.substr(dot);
+  }
+  time_t now = time(NULL);
+  struct tm utc;
+  gmtime_r(&now, &utc);
+  char date[32];
+  strftime(date, sizeof(date), "-%Y%m%d-%H%M%S", &utc);
+  std::string path = stem + date + extension;
+  // More than one file in a second when rotating on size
+  for (int i = 1; access(path.c_str(), F_OK) == 0; i++) {
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "-%d", i);
+    path = stem + date + suffix + extension;
+  }
+  return path;
+}
+
+bool AsyncLogWriter::openFile()
+{
+  std::string path = nextPath();
+  if (options_.ascii) {
+    ascii_ = fopen(path.c_str(), "w");
+    if (!ascii_)
+      return fail("couldn't open " + path + ": " + strerror(errno));
+    ascii_bytes_ = 0;
+  }
+  else if (!binary_.open(path, device_, baud_, units_, 0, options_.batch_size, options_.compress)) {
+    return fail(binary_.error());
+  }
+  opened_ns_ = synced_ns_ = monotonic_ns();
+  ++files_;
+  return true;
+}
+
+bool AsyncLogWriter::syncFile()
+{
+  if (options_.ascii ? !ascii_ : !binary_.isOpen())
+    return true;
+  synced_ns_ = monotonic_ns();
+  if (options_.ascii) {
+    if (fflush(ascii_) == EOF || fdatasync(fileno(ascii_)) < 0)
+      return fail(std::string("couldn't sync log: ") + strerror(errno));
+  }
+  else if (!(binary_.flush() && binary_.sync())) {
+    return fail(binary_.error());
+  }
+  ++syncs_;
+  return true;
+}
+
+// Synced on the way out, whatever sync_seconds says: a closed file is one
+// that shouldn't need looking at again.
+bool AsyncLogWriter::closeFile()
+{
+  bool ok = syncFile();
+  if (options_.ascii) {
+    if (ascii_ && fclose(ascii_) == EOF && ok)
+      ok = fail(std::string("couldn't close log: ") + strerror(errno));
+    ascii_ = NULL;
+  }
+  else if (!binary_.close() && ok) {
+    ok = fail(binary_.error());
+  }
+  return ok;
+}
+
+} // namespace sicktoolbox_pls_wrapper
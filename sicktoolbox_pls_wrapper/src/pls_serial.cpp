@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+// raw serial port access for talking to a PLS without sicktoolbox.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/pls_serial.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+static bool termios_speed(uint32_t baud, speed_t *speed)
+{
+  switch (baud)
+  {
+    case 9600: *speed = B9600; return true;
+    case 19200: *speed = B19200; return true;
+    case 38400: *speed = B38400; return true;
+#ifdef B500000
+    case 500000: *speed = B500000; return true;
+#endif
+    default: return false;
+  }
+}
+
+bool pls_set_serial_baud(int fd, uint32_t baud)
+{
+  speed_t speed;
+  struct termios term;
+  if (!termios_speed(baud, &speed) || tcgetattr(fd, &term) < 0)
+    return false;
+  cfsetispeed(&term, speed);
+  cfsetospeed(&term, speed);
+  if (tcsetattr(fd, TCSAFLUSH, &term) < 0)
+    return false;
+  return true;
+}
+
+int pls_open_serial(const std::string &device, uint32_t baud, std::string *error)
+{
+  int fd = open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) {
+    *error = "couldn't open " + device + ": " + strerror(errno);
+    return -1;
+  }
+  struct termios term;
+  if (tcgetattr(fd, &term) < 0) {
+    *error = std::string("tcgetattr failed: ") + strerror(errno);
+    close(fd);
+    return -1;
+  }
+  cfmakeraw(&term);
+  term.c_cflag |= CLOCAL | CREAD;
+  term.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+  term.c_cc[VMIN] = 0;
+  term.c_cc[VTIME] = 0;
+  if (tcsetattr(fd, TCSANOW, &term) < 0 || !pls_set_serial_baud(fd, baud)) {
+    *error = "couldn't set up " + device + ": " + strerror(errno);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool pls_write_serial(int fd, const uint8_t *data, size_t length)
+{
+  while (length > 0) {
+    ssize_t n = write(fd, data, length);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN)
+        return false;
+      struct pollfd pfd = { fd, POLLOUT, 0 };
+      if (poll(&pfd, 1, 100) < 0 && errno != EINTR)
+        return false;
+      continue;
+    }
+    data += n;
+    length -= n;
+  }
+  return tcdrain(fd) == 0;
+}
+
+ssize_t pls_read_serial(int fd, uint8_t *buffer, size_t size, double timeout)
+{
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  int ready = poll(&pfd, 1, (int)(timeout * 1000));
+  if (ready < 0)
+    return errno == EINTR ? 0 : -1;
+  if (ready == 0)
+    return 0;
+  ssize_t n = read(fd, buffer, size);
+  if (n < 0)
+    return errno == EAGAIN || errno == EINTR ? 0 : -1;
+  if (n == 0) // readable but empty: the port hung up
+    return -1;
+  return n;
+}
+
+} // namespace sicktoolbox_pls_wrapper
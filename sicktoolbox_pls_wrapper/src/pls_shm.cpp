@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////
+// the driver's side of the shared-memory scan ring.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <climits>
+#include <sicktoolbox_pls_wrapper/pls_shm.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+static void copy_string(char *dst, size_t size, const std::string &src)
+{
+  strncpy(dst, src.c_str(), size - 1);
+  dst[size - 1] = '\0';
+}
+
+PlsShmWriter::PlsShmWriter()
+  : fd_(-1), header_(NULL), length_(0), scans_(0)
+{
+}
+
+PlsShmWriter::~PlsShmWriter()
+{
+  close();
+}
+
+bool PlsShmWriter::open(const std::string &name, const std::string &device, uint32_t slot_count)
+{
+  close();
+  if (slot_count < 2)
+    slot_count = 2;
+  size_t length = sizeof(PlsShmHeader) + (size_t)slot_count * sizeof(PlsShmSlot);
+
+  fd_ = shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ < 0)
+    return fail("Can't create " + name + ": " + strerror(errno));
+  // A segment of another size can't be reused; readers mapping it would
+  // fault. Start a fresh one under the same name instead.
+  struct stat st;
+  if (fstat(fd_, &st) < 0)
+    return fail("Can't stat " + name + ": " + strerror(errno));
+  if (st.st_size != 0 && (size_t)st.st_size != length) {
+    ::close(fd_);
+    shm_unlink(name.c_str());
+    fd_ = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd_ < 0)
+      return fail("Can't create " + name + ": " + strerror(errno));
+  }
+  if (ftruncate(fd_, length) < 0)
+    return fail("Can't size " + name + ": " + strerror(errno));
+  void *p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED)
+    return fail("Can't map " + name + ": " + strerror(errno));
+  header_ = static_cast<PlsShmHeader *>(p);
+  length_ = length;
+
+  // Readers that still have the segment mapped see it go away and come
+  // back; the slot sequences carry on from where they were so that nobody
+  // mistakes a half-written slot for a whole one.
+  memset(header_->magic, 0, sizeof(header_->magic));
+  __sync_synchronize();
+  header_->version = PLS_SHM_VERSION;
+  header_->header_size = sizeof(PlsShmHeader);
+  header_->slot_size = sizeof(PlsShmSlot);
+  header_->slot_count = slot_count;
+  header_->max_ranges = PLS_SHM_MAX_RANGES;
+  header_->writer_pid = getpid();
+  copy_string(header_->device, sizeof(header_->device), device);
+  header_->latest = 0;
+  scans_ = 0;
+  for (uint32_t i = 0; i < slot_count; i++) {
+    PlsShmSlot *slot = reinterpret_cast<PlsShmSlot *>(reinterpret_cast<char *>(header_) +
+                                                      header_->header_size) + i;
+    slot->sequence += slot->sequence & 1;
+    slot->scan = 0;
+  }
+  __sync_synchronize();
+  memcpy(header_->magic, PLS_SHM_MAGIC, sizeof(PLS_SHM_MAGIC));
+  return true;
+}
+
+void PlsShmWriter::setGeometry(float scale, float angle_min, float angle_increment, float scan_time,
+                               const std::string &frame_id)
+{
+  if (!header_)
+    return;
+  header_->scale = scale;
+  header_->angle_min = angle_min;
+  header_->angle_increment = angle_increment;
+  header_->scan_time = scan_time;
+  copy_string(header_->frame_id, sizeof(header_->frame_id), frame_id);
+  __sync_synchronize();
+}
+
+void PlsShmWriter::write(uint64_t stamp_ns, const uint32_t *range_values, uint32_t n_range_values)
+{
+  if (!header_)
+    return;
+  uint64_t scan = ++scans_;
+  PlsShmSlot *slot = reinterpret_cast<PlsShmSlot *>(reinterpret_cast<char *>(header_) +
+                                                    header_->header_size) + scan % header_->slot_count;
+  uint32_t n = n_range_values < PLS_SHM_MAX_RANGES ? n_range_values : PLS_SHM_MAX_RANGES;
+
+  slot->sequence++; // odd: keep out
+  __sync_synchronize();
+  slot->num_ranges = n;
+  slot->scan = scan;
+  slot->stamp_ns = stamp_ns;
+  for (uint32_t i = 0; i < n; i++)
+    slot->ranges[i] = range_values[i];
+  __sync_synchronize();
+  slot->sequence++;
+
+  header_->latest = scan;
+  __sync_fetch_and_add(&header_->futex, 1);
+  syscall(SYS_futex, &header_->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void PlsShmWriter::close()
+{
+  if (header_) {
+    header_->writer_pid = 0;
+    munmap(header_, length_);
+  }
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  header_ = NULL;
+  length_ = 0;
+}
+
+bool PlsShmWriter::fail(const std::string &what)
+{
+  error_ = what;
+  close();
+  return false;
+}
+
+} // namespace sicktoolbox_pls_wrapper
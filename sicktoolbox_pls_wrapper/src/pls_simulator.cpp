@@ -0,0 +1,374 @@
+///////////////////////////////////////////////////////////////////////////////
+// a PLS simulated on a pty.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/pls_simulator.h>
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <sicktoolbox_pls_wrapper/pls_telegram.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+static const uint8_t STATUS_OK = 0x00;  // the status byte that ends every response
+static const uint8_t PLS_CMD_MEASURED_VALUES = 0x30;
+static const uint16_t RANGE_MASK = 0x1fff;
+
+static uint32_t mode_baud(uint8_t mode)
+{
+  const uint32_t rates[] = { 9600, 19200, 38400, 500000 };
+  for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+    if (pls_baud_mode(rates[i]) == mode)
+      return rates[i];
+  return 0;
+}
+
+static bool baud_speed(uint32_t baud, speed_t *speed)
+{
+  switch (baud)
+  {
+    case 9600: *speed = B9600; return true;
+    case 19200: *speed = B19200; return true;
+    case 38400: *speed = B38400; return true;
+#ifdef B500000
+    case 500000: *speed = B500000; return true;
+#endif
+    default: return false;
+  }
+}
+
+PlsSimulator::PlsSimulator(const PlsSimulatorConfig &config)
+  : config_(config), master_(-1), slave_(-1), seed_(config.seed), baud_(config.baud), pending_baud_(0),
+    continuous_(false), scan_requested_(false), period_ns_(0), grid_ns_(0), next_scan_ns_(0),
+    scan_index_(0), out_start_(0), tx_start_ns_(0), scan_in_flight_(false), scan_end_(0), scans_(0),
+    scans_sent_(0), commands_(0), bytes_dropped_(0), crc_errors_(0)
+{
+}
+
+PlsSimulator::~PlsSimulator()
+{
+  close();
+}
+
+bool PlsSimulator::open()
+{
+  close();
+  if (config_.num_values < 2 || config_.num_values > 361 || config_.scan_rate <= 0 ||
+      !pls_baud_mode(config_.baud)) {
+    error_ = "unsupported simulator configuration";
+    return false;
+  }
+  speed_t speed;
+  if (!baud_speed(config_.baud, &speed)) {
+    char what[64];
+    snprintf(what, sizeof(what), "this system can't run a pty at %u baud", config_.baud);
+    error_ = what;
+    return false;
+  }
+  master_ = posix_openpt(O_RDWR | O_NOCTTY);
+  char name[64];
+  if (master_ < 0 || grantpt(master_) < 0 || unlockpt(master_) < 0 ||
+      ptsname_r(master_, name, sizeof(name)) != 0) {
+    error_ = std::string("couldn't create a pty: ") + strerror(errno);
+    close();
+    return false;
+  }
+  device_path_ = name;
+  // Held open so the pty outlives hosts coming and going, and made raw
+  // before any host opens it, so nothing we send is echoed back to us.
+  slave_ = ::open(name, O_RDWR | O_NOCTTY);
+  struct termios term;
+  if (slave_ < 0 || tcgetattr(slave_, &term) < 0) {
+    error_ = "couldn't open " + device_path_ + ": " + strerror(errno);
+    close();
+    return false;
+  }
+  cfmakeraw(&term);
+  cfsetispeed(&term, speed);
+  cfsetospeed(&term, speed);
+  if (tcsetattr(slave_, TCSANOW, &term) < 0 ||
+      fcntl(master_, F_SETFL, fcntl(master_, F_GETFL) | O_NONBLOCK) < 0) {
+    error_ = "couldn't set up " + device_path_ + ": " + strerror(errno);
+    close();
+    return false;
+  }
+
+  // Walls 4 m either side of the laser and 6 m in front of it
+  room_.resize(config_.num_values);
+  for (uint32_t i = 0; i < config_.num_values; i++) {
+    double angle = M_PI * i / (config_.num_values - 1);
+    double x = cos(angle), y = sin(angle);
+    double r = 819.0;
+    if (fabs(x) > 1e-9)
+      r = std::min(r, 400.0 / fabs(x));
+    if (y > 1e-9)
+      r = std::min(r, 600.0 / y);
+    room_[i] = r;
+  }
+
+  baud_ = config_.baud;
+  pending_baud_ = 0;
+  continuous_ = false;
+  scan_requested_ = false;
+  period_ns_ = (uint64_t)(1e9 / config_.scan_rate);
+  grid_ns_ = next_scan_ns_ = monotonic_ns() + period_ns_;
+  scan_index_ = 0;
+  in_.clear();
+  out_.clear();
+  out_start_ = 0;
+  scan_in_flight_ = false;
+  scan_end_ = 0;
+  return true;
+}
+
+void PlsSimulator::close()
+{
+  if (slave_ >= 0)
+    ::close(slave_);
+  if (master_ >= 0)
+    ::close(master_);
+  slave_ = master_ = -1;
+}
+
+double PlsSimulator::random()
+{
+  return (rand_r(&seed_) + 1.0) / (RAND_MAX + 1.0);
+}
+
+double PlsSimulator::gaussian()
+{
+  return sqrt(-2 * log(random())) * cos(2 * M_PI * random());
+}
+
+uint32_t PlsSimulator::hostBaud() const
+{
+  struct termios term;
+  if (tcgetattr(slave_, &term) < 0)
+    return 0;
+  const uint32_t rates[] = { 9600, 19200, 38400, 500000 };
+  for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+    speed_t speed;
+    if (baud_speed(rates[i], &speed) && cfgetospeed(&term) == speed)
+      return rates[i];
+  }
+  return 0;
+}
+
+bool PlsSimulator::handleInput(uint64_t now_ns)
+{
+  uint8_t buffer[4096];
+  for (;;) {
+    ssize_t n = read(master_, buffer, sizeof(buffer));
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN)
+        break;
+      error_ = std::string("reading the pty failed: ") + strerror(errno);
+      return false;
+    }
+    if (n == 0)
+      break;
+    // At the wrong rate it's all noise to us
+    if (hostBaud() == baud_)
+      in_.insert(in_.end(), buffer, buffer + n);
+  }
+
+  size_t pos = 0;
+  while (in_.size() - pos >= 4) {
+    const uint8_t *p = &in_[pos];
+    size_t length = p[2] | (p[3] << 8);
+    if (p[0] != PLS_STX || p[1] != PLS_HOST_ADDRESS || length == 0 || length > PLS_MAX_PAYLOAD) {
+      pos++;
+      continue;
+    }
+    size_t total = length + PLS_TELEGRAM_OVERHEAD;
+    if (in_.size() - pos < total)
+      break;
+    uint16_t crc = p[total - 2] | (p[total - 1] << 8);
+    if (crc != pls_crc16(p, total - 2)) {
+      queue(&PLS_NACK, 1, now_ns);
+      pos++;
+      continue;
+    }
+    queue(&PLS_ACK, 1, now_ns);
+    handleTelegram(p + 4, length, now_ns);
+    pos += total;
+  }
+  in_.erase(in_.begin(), in_.begin() + pos);
+  flush(now_ns);
+  return true;
+}
+
+void PlsSimulator::handleTelegram(const uint8_t *payload, size_t length, uint64_t now_ns)
+{
+  commands_++;
+  if (payload[0] == PLS_CMD_SWITCH_MODE && length >= 2) {
+    uint8_t mode = payload[1];
+    uint32_t baud = mode_baud(mode);
+    bool ok = true;
+    if (baud)
+      pending_baud_ = baud;
+    else if (mode == PLS_MODE_CONTINUOUS)
+      continuous_ = true;
+    else if (mode == PLS_MODE_ON_REQUEST)
+      continuous_ = false;
+    else
+      ok = false;
+    uint8_t response[3] = { PLS_CMD_SWITCH_MODE | PLS_RESPONSE_OFFSET, (uint8_t)(ok ? 0x00 : 0x01), STATUS_OK };
+    reply(response, sizeof(response), now_ns);
+  }
+  else if (payload[0] == PLS_CMD_MEASURED_VALUES) {
+    scan_requested_ = true; // answered with the next scan
+  }
+}
+
+void PlsSimulator::reply(const uint8_t *payload, size_t length, uint64_t now_ns)
+{
+  uint8_t telegram[PLS_MAX_PAYLOAD + PLS_TELEGRAM_OVERHEAD];
+  size_t total = pls_build_telegram(payload, length, telegram, PLS_DEVICE_ADDRESS);
+  queue(telegram, total, now_ns);
+}
+
+void PlsSimulator::queue(const uint8_t *data, size_t length, uint64_t now_ns)
+{
+  if (out_start_ == out_.size()) {
+    out_.clear();
+    out_start_ = 0;
+    scan_end_ = 0;
+    tx_start_ns_ = now_ns;
+  }
+  out_.insert(out_.end(), data, data + length);
+}
+
+void PlsSimulator::sendScan(uint64_t now_ns)
+{
+  const uint32_t n = config_.num_values;
+  uint8_t payload[4 + 2 * 361];
+  payload[0] = PLS_RESP_MEASURED_VALUES;
+  payload[1] = n & 0xff;
+  payload[2] = n >> 8;
+  // Something a metre and a half out, walking back and forth
+  double t = scan_index_ / config_.scan_rate;
+  double walker = M_PI / 2 + M_PI / 3 * sin(2 * M_PI * t / 10);
+  for (uint32_t i = 0; i < n; i++) {
+    double angle = M_PI * i / (n - 1);
+    double r = room_[i];
+    if (fabs(angle - walker) < 0.08)
+      r = std::min(r, 150.0);
+    int value = (int)(r + 1.5 * gaussian() + 0.5);
+    value = std::max(0, std::min(value, (int)RANGE_MASK));
+    payload[3 + 2 * i] = value & 0xff;
+    payload[4 + 2 * i] = value >> 8;
+  }
+  size_t length = 4 + 2 * n;
+  payload[length - 1] = STATUS_OK;
+
+  uint8_t telegram[sizeof(payload) + PLS_TELEGRAM_OVERHEAD];
+  size_t total = pls_build_telegram(payload, length, telegram, PLS_DEVICE_ADDRESS);
+  if (config_.crc_error_rate > 0 && random() < config_.crc_error_rate) {
+    size_t i = 4 + rand_r(&seed_) % (total - 6);
+    telegram[i] ^= 1 + rand_r(&seed_) % 255;
+    crc_errors_++;
+  }
+  if (config_.drop_rate > 0 && random() < config_.drop_rate) {
+    size_t i = rand_r(&seed_) % total;
+    memmove(telegram + i, telegram + i + 1, total - i - 1);
+    total--;
+    bytes_dropped_++;
+  }
+  queue(telegram, total, now_ns);
+  scan_end_ = out_.size();
+  scan_in_flight_ = true;
+  scans_sent_++;
+}
+
+void PlsSimulator::flush(uint64_t now_ns)
+{
+  size_t pending = out_.size() - out_start_;
+  if (pending == 0)
+    return;
+  double bytes_per_ns = baud_ / 10.0 * 1e-9;
+  size_t due = pending;
+  if (config_.paced)
+    due = std::min(pending, (size_t)((now_ns - tx_start_ns_) * bytes_per_ns));
+  if (due == 0)
+    return;
+  if (hostBaud() == baud_) {
+    ssize_t n = write(master_, &out_[out_start_], due);
+    // A line doesn't wait for a host that isn't reading, so what doesn't
+    // fit is lost the same way.
+    if (n < 0 && errno != EAGAIN && errno != EINTR)
+      error_ = std::string("writing the pty failed: ") + strerror(errno);
+  }
+  out_start_ += due;
+  tx_start_ns_ += (uint64_t)(due / bytes_per_ns);
+  scan_in_flight_ = out_start_ < scan_end_;
+  if (out_start_ == out_.size() && pending_baud_) {
+    baud_ = pending_baud_;
+    pending_baud_ = 0;
+  }
+}
+
+uint64_t PlsSimulator::service(uint64_t now_ns)
+{
+  if (now_ns >= next_scan_ns_) {
+    scans_++;
+    scan_index_++;
+    // A continuous PLS sends the latest scan whenever the line is free
+    // for it, so at slow rates only every so many make it out.
+    if (scan_requested_ || (continuous_ && !scan_in_flight_))
+      sendScan(now_ns);
+    scan_requested_ = false;
+    grid_ns_ += period_ns_;
+    if (grid_ns_ + period_ns_ < now_ns)
+      grid_ns_ = now_ns; // fell behind; don't try to catch up
+    int64_t jitter = 0;
+    if (config_.jitter > 0) {
+      jitter = (int64_t)(gaussian() * config_.jitter * 1e9);
+      jitter = std::max(std::min(jitter, (int64_t)period_ns_ / 2), -(int64_t)period_ns_ / 2);
+    }
+    next_scan_ns_ = grid_ns_ + jitter;
+  }
+  flush(now_ns);
+  uint64_t next = next_scan_ns_;
+  if (out_start_ < out_.size()) {
+    // Write in chunks of at least a millisecond's worth
+    next = std::min(next, config_.paced ? now_ns + 1000000 : now_ns);
+  }
+  return next;
+}
+
+} // namespace sicktoolbox_pls_wrapper
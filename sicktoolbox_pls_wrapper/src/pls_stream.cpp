@@ -0,0 +1,259 @@
+///////////////////////////////////////////////////////////////////////////////
+// reading a PLS in continuous output mode, bypassing sicktoolbox.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/pls_stream.h>
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <sicktoolbox_pls_wrapper/pls_serial.h>
+#include <sicktoolbox_pls_wrapper/pls_telegram.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Measured values: the response byte, a word whose low 10 bits count the
+// values, the values as words with the range in cm in the low 13 bits and
+// the PlsScan::ReadingStatus flags in the top 3, and a status byte.
+static const size_t VALUES_OFFSET = 7;
+static const uint16_t VALUE_COUNT_MASK = 0x03ff;
+static const uint16_t RANGE_MASK = 0x1fff;
+static const int FLAGS_SHIFT = 13;
+static const uint32_t MAX_VALUES = 361;
+
+PlsStream::PlsStream(size_t buffer_size)
+  : fd_(-1), baud_(0), buffer_(std::max(buffer_size, 4 * (PLS_MAX_PAYLOAD + PLS_TELEGRAM_OVERHEAD))),
+    start_(0), end_(0), telegrams_(0), crc_errors_(0), discarded_(0), bytes_read_(0), reads_(0)
+{
+}
+
+PlsStream::~PlsStream()
+{
+  close();
+}
+
+bool PlsStream::open(const std::string &device, uint32_t baud, uint32_t cached_baud)
+{
+  close();
+  if (!pls_baud_mode(baud)) {
+    error_ = "unsupported baud rate";
+    return false;
+  }
+
+  const uint32_t rates[] = { cached_baud, 9600, 19200, 38400, 500000 };
+  for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+    if (!rates[i] || (i > 0 && rates[i] == cached_baud))
+      continue;
+    fd_ = pls_open_serial(device, rates[i], &error_);
+    if (fd_ < 0)
+      return false;
+    start_ = end_ = 0;
+    if (command(pls_baud_mode(baud), 0.3)) {
+      // The PLS answers at the old rate and switches once it has.
+      if (!pls_set_serial_baud(fd_, baud)) {
+        error_ = std::string("couldn't switch the port's baud rate: ") + strerror(errno);
+        break;
+      }
+      baud_ = baud;
+      start_ = end_ = 0;
+      if (command(PLS_MODE_CONTINUOUS, 0.5))
+        return true;
+      error_ = "the PLS didn't start continuous output";
+      break;
+    }
+    ::close(fd_);
+    fd_ = -1;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  else {
+    error_ = "no answer from the PLS at any baud rate";
+  }
+  return false;
+}
+
+void PlsStream::close()
+{
+  if (fd_ < 0)
+    return;
+  // Best effort: the port may be what failed.
+  if (command(PLS_MODE_ON_REQUEST, 0.2) && baud_ != 9600)
+    command(pls_baud_mode(9600), 0.2);
+  ::close(fd_);
+  fd_ = -1;
+}
+
+bool PlsStream::command(uint8_t mode, double timeout)
+{
+  uint8_t payload[2] = { PLS_CMD_SWITCH_MODE, mode };
+  uint8_t telegram[sizeof(payload) + PLS_TELEGRAM_OVERHEAD];
+  size_t length = pls_build_telegram(payload, sizeof(payload), telegram);
+  if (!pls_write_serial(fd_, telegram, length)) {
+    error_ = std::string("couldn't write to the PLS: ") + strerror(errno);
+    return false;
+  }
+
+  // The PLS ACKs first, but an ACK byte is indistinguishable from data when
+  // it's already streaming; the checksummed reply isn't.
+  uint64_t deadline = monotonic_ns() + (uint64_t)(timeout * 1e9);
+  for (;;) {
+    const uint8_t *reply;
+    while ((reply = nextTelegram()) != NULL) {
+      if (reply[4] == (PLS_CMD_SWITCH_MODE | PLS_RESPONSE_OFFSET))
+        return reply[5] == 0x00;
+    }
+    uint64_t now = monotonic_ns();
+    if (now >= deadline || fill((deadline - now) * 1e-9) < 0)
+      return false;
+  }
+}
+
+int PlsStream::fill(double timeout)
+{
+  if (start_ == end_) {
+    start_ = end_ = 0;
+  }
+  else if (buffer_.size() - end_ < PLS_MAX_PAYLOAD + PLS_TELEGRAM_OVERHEAD) {
+    // Whatever is left is less than one telegram.
+    memmove(&buffer_[0], &buffer_[start_], end_ - start_);
+    end_ -= start_;
+    start_ = 0;
+  }
+  ssize_t n = pls_read_serial(fd_, &buffer_[end_], buffer_.size() - end_, timeout);
+  if (n < 0) {
+    error_ = std::string("reading the PLS failed: ") + strerror(errno);
+    return -1;
+  }
+  end_ += n;
+  bytes_read_ += n;
+  if (n > 0)
+    reads_++;
+  return n > 0;
+}
+
+const uint8_t *PlsStream::nextTelegram()
+{
+  while (end_ - start_ >= 4) {
+    uint8_t *p = &buffer_[start_];
+    if (p[0] != PLS_STX || p[1] != PLS_DEVICE_ADDRESS) {
+      // Skip to the next possible start; ACKs end up here too.
+      uint8_t *stx = static_cast<uint8_t *>(memchr(p + 1, PLS_STX, end_ - start_ - 1));
+      size_t skip = stx ? stx - p : end_ - start_;
+      start_ += skip;
+      discarded_ += skip;
+      continue;
+    }
+    size_t length = p[2] | (p[3] << 8);
+    if (length == 0 || length > PLS_MAX_PAYLOAD) {
+      start_++;
+      discarded_++;
+      continue;
+    }
+    size_t total = length + PLS_TELEGRAM_OVERHEAD;
+    if (end_ - start_ < total)
+      return NULL;
+    uint16_t crc = p[total - 2] | (p[total - 1] << 8);
+    if (crc != pls_crc16(p, total - 2)) {
+      // Most likely an STX inside another telegram; resync past it.
+      crc_errors_++;
+      start_++;
+      discarded_++;
+      continue;
+    }
+    start_ += total;
+    telegrams_++;
+    return p;
+  }
+  return NULL;
+}
+
+int PlsStream::nextScan(double timeout, const uint8_t *&telegram, uint32_t &n)
+{
+  if (fd_ < 0) {
+    error_ = "not open";
+    return -1;
+  }
+  uint64_t deadline = monotonic_ns() + (uint64_t)(timeout * 1e9);
+  for (;;) {
+    const uint8_t *t;
+    while ((t = nextTelegram()) != NULL) {
+      size_t length = t[2] | (t[3] << 8);
+      if (t[4] != PLS_RESP_MEASURED_VALUES || length < 3)
+        continue;
+      n = (t[5] | (t[6] << 8)) & VALUE_COUNT_MASK;
+      if (n > MAX_VALUES || length < 4 + 2 * n)
+        continue;
+      telegram = t;
+      return 1;
+    }
+    uint64_t now = monotonic_ns();
+    if (now >= deadline)
+      return 0;
+    if (fill((deadline - now) * 1e-9) < 0)
+      return -1;
+  }
+}
+
+int PlsStream::next(uint32_t *range_values, uint32_t &n_range_values, double timeout)
+{
+  const uint8_t *t;
+  uint32_t n;
+  int got = nextScan(timeout, t, n);
+  if (got <= 0)
+    return got;
+  const uint8_t *values = t + VALUES_OFFSET;
+  for (uint32_t i = 0; i < n; i++)
+    range_values[i] = (values[2 * i] | (values[2 * i + 1] << 8)) & RANGE_MASK;
+  n_range_values = n;
+  return 1;
+}
+
+int PlsStream::next(PlsScan &scan, double timeout)
+{
+  const uint8_t *t;
+  uint32_t n;
+  int got = nextScan(timeout, t, n);
+  if (got <= 0)
+    return got;
+  const uint8_t *values = t + VALUES_OFFSET;
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t value = values[2 * i] | (values[2 * i + 1] << 8);
+    uint32_t range = value & RANGE_MASK;
+    scan.ranges[i] = range;
+    scan.status[i] = (value >> FLAGS_SHIFT) | (range > PLS_MAX_VALID_RANGE ? PlsScan::INVALID : 0);
+  }
+  scan.size = n;
+  scan.device_status = values[2 * n];
+  scan.fields |= PlsScan::STATUS | PlsScan::DEVICE_STATUS;
+  return 1;
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// per-scan timing trace files written by the driver.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/pls_trace.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+PlsTraceWriter::PlsTraceWriter()
+  : fd_(-1), pending_(0)
+{
+}
+
+PlsTraceWriter::~PlsTraceWriter()
+{
+  close();
+}
+
+bool PlsTraceWriter::fail(const std::string &what)
+{
+  error_ = what + ": " + strerror(errno);
+  return false;
+}
+
+bool PlsTraceWriter::open(const std::string &path, const std::string &device, size_t batch_size)
+{
+  close();
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0)
+    return fail("couldn't open " + path);
+
+  PlsTraceHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PLS_TRACE_MAGIC, sizeof(header.magic));
+  header.version = PLS_TRACE_VERSION;
+  header.header_size = sizeof(PlsTraceHeader);
+  header.record_size = sizeof(PlsTraceRecord);
+  strncpy(header.device, device.c_str(), sizeof(header.device) - 1);
+  if (write(fd_, &header, sizeof(header)) != (ssize_t)sizeof(header))
+    return fail("couldn't write trace header");
+
+  batch_.resize(batch_size ? batch_size : 1);
+  pending_ = 0;
+  return true;
+}
+
+bool PlsTraceWriter::flush()
+{
+  if (fd_ < 0)
+    return false;
+  size_t bytes = pending_ * sizeof(PlsTraceRecord);
+  pending_ = 0;
+  if (bytes && write(fd_, &batch_[0], bytes) != (ssize_t)bytes)
+    return fail("couldn't write trace records");
+  return true;
+}
+
+bool PlsTraceWriter::close()
+{
+  if (fd_ < 0)
+    return true;
+  bool ok = flush();
+  if (::close(fd_) < 0 && ok)
+    ok = fail("couldn't close trace");
+  fd_ = -1;
+  return ok;
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+// scans as fixed-layout UDP datagrams, usually multicast: the driver's
+// batched sender and a header-only receiver for consumers without ROS.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/pls_udp.h>
+#include <algorithm>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+static inline float float_to_le(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bits = htole32(bits);
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+PlsUdpSender::PlsUdpSender()
+  : fd_(-1), queued_(0), sent_(0), dropped_(0), flushes_(0)
+{
+  memset(&destination_, 0, sizeof(destination_));
+}
+
+PlsUdpSender::~PlsUdpSender()
+{
+  close();
+}
+
+bool PlsUdpSender::open(const std::string &destination, const std::string &interface, int ttl,
+                        bool loopback, size_t batch)
+{
+  close();
+  if (!pls_udp_parse_address(destination, destination_)) {
+    error_ = "expected address:port, not " + destination;
+    return false;
+  }
+  fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    error_ = std::string("socket failed: ") + strerror(errno);
+    return false;
+  }
+  if (IN_MULTICAST(ntohl(destination_.sin_addr.s_addr))) {
+    unsigned char multicast_ttl = std::max(0, std::min(ttl, 255));
+    unsigned char multicast_loop = loopback;
+    struct in_addr local;
+    local.s_addr = htonl(INADDR_ANY);
+    bool ok = interface.empty() || inet_aton(interface.c_str(), &local) != 0;
+    if (!ok) {
+      error_ = "expected an IPv4 address for the interface, not " + interface;
+    }
+    else if (setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_TTL, &multicast_ttl, sizeof(multicast_ttl)) < 0 ||
+             setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &multicast_loop, sizeof(multicast_loop)) < 0 ||
+             (!interface.empty() && setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_IF, &local, sizeof(local)) < 0)) {
+      error_ = std::string("couldn't set up multicast: ") + strerror(errno);
+      ok = false;
+    }
+    if (!ok) {
+      close();
+      return false;
+    }
+  }
+
+  // Everything a flush needs, pointed at once
+  batch = std::max(batch, (size_t)1);
+  buffers_.assign(batch * PLS_UDP_MAX_DATAGRAM, 0);
+  messages_.resize(batch);
+  iovecs_.resize(batch);
+  for (size_t i = 0; i < batch; i++) {
+    iovecs_[i].iov_base = &buffers_[i * PLS_UDP_MAX_DATAGRAM];
+    iovecs_[i].iov_len = 0;
+    memset(&messages_[i], 0, sizeof(messages_[i]));
+    messages_[i].msg_hdr.msg_name = &destination_;
+    messages_[i].msg_hdr.msg_namelen = sizeof(destination_);
+    messages_[i].msg_hdr.msg_iov = &iovecs_[i];
+    messages_[i].msg_hdr.msg_iovlen = 1;
+  }
+  queued_ = 0;
+  return true;
+}
+
+void PlsUdpSender::close()
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  queued_ = 0;
+}
+
+void PlsUdpSender::add(const PlsUdpHeader &header, const uint32_t *range_values, uint32_t n_range_values)
+{
+  if (fd_ < 0)
+    return;
+  if (queued_ == messages_.size())
+    flush();
+  uint32_t n = std::min(n_range_values, PLS_UDP_MAX_RANGES);
+  uint8_t *datagram = static_cast<uint8_t *>(iovecs_[queued_].iov_base);
+
+  PlsUdpHeader h;
+  h.magic = htole32(PLS_UDP_MAGIC);
+  h.version = htole16(PLS_UDP_VERSION);
+  h.header_size = htole16(sizeof(PlsUdpHeader));
+  h.sequence = htole32(header.sequence);
+  h.sensor = htole16(header.sensor);
+  h.num_ranges = htole16(n);
+  h.host_stamp_ns = htole64(header.host_stamp_ns);
+  h.device_stamp_ns = htole64(header.device_stamp_ns);
+  h.scale = float_to_le(header.scale);
+  h.angle_min = float_to_le(header.angle_min);
+  h.angle_increment = float_to_le(header.angle_increment);
+  h.scan_time = float_to_le(header.scan_time);
+  memcpy(datagram, &h, sizeof(h));
+  uint8_t *ranges = datagram + sizeof(h);
+  for (uint32_t i = 0; i < n; i++) {
+    uint16_t value = htole16(range_values[i]);
+    memcpy(ranges + 2 * i, &value, sizeof(value));
+  }
+  iovecs_[queued_].iov_len = sizeof(h) + n * sizeof(uint16_t);
+  queued_++;
+}
+
+void PlsUdpSender::flush()
+{
+  size_t done = 0;
+  while (done < queued_) {
+    int n = sendmmsg(fd_, &messages_[done], queued_ - done, MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      // A full socket buffer or nobody on the link; not worth waiting for
+      dropped_ += queued_ - done;
+      break;
+    }
+    sent_ += n;
+    done += n;
+  }
+  if (queued_)
+    flushes_++;
+  queued_ = 0;
+}
+
+} // namespace sicktoolbox_pls_wrapper
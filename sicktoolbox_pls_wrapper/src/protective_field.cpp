@@ -0,0 +1,230 @@
+///////////////////////////////////////////////////////////////////////////////
+// a protective field checked on raw readings through a per-reading threshold
+// table, and the UDP and GPIO outputs that signal it.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/protective_field.h>
+#include <sicktoolbox_pls_wrapper/range_conversion.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+ProtectiveField::ProtectiveField()
+  : first_angle_(0), last_angle_(0), scale_(0)
+{
+}
+
+void ProtectiveField::setPolygon(const std::vector<double> &xy)
+{
+  polygon_ = xy;
+  if (polygon_.size() % 2 || polygon_.size() < 6)
+    polygon_.clear();
+  far_.clear();
+}
+
+void ProtectiveField::addSector(double angle_min, double angle_max, double range)
+{
+  Sector sector;
+  sector.angle_min = std::min(angle_min, angle_max);
+  sector.angle_max = std::max(angle_min, angle_max);
+  sector.range = range;
+  sectors_.push_back(sector);
+  far_.clear();
+}
+
+bool ProtectiveField::extent(double angle, double &near, double &far) const
+{
+  bool found = false;
+  near = HUGE_VAL;
+  far = 0;
+
+  double dx = cos(angle), dy = sin(angle);
+  size_t vertices = polygon_.size() / 2;
+  size_t crossings = 0;
+  for (size_t i = 0; i < vertices; i++) {
+    double ax = polygon_[2 * i], ay = polygon_[2 * i + 1];
+    size_t j = (i + 1) % vertices;
+    double ex = polygon_[2 * j] - ax, ey = polygon_[2 * j + 1] - ay;
+    // origin + t d = a + u e
+    double denom = dx * ey - dy * ex;
+    if (fabs(denom) < 1e-12)
+      continue;
+    double t = (ax * ey - ay * ex) / denom;
+    double u = (ax * dy - ay * dx) / denom;
+    if (t < 0 || u < 0 || u >= 1)
+      continue;
+    crossings++;
+    near = std::min(near, t);
+    far = std::max(far, t);
+    found = true;
+  }
+  // An odd number of crossings on the way out means the laser is inside.
+  if (crossings % 2)
+    near = 0;
+
+  for (size_t i = 0; i < sectors_.size(); i++) {
+    const Sector &s = sectors_[i];
+    if (angle >= s.angle_min && angle <= s.angle_max) {
+      near = 0;
+      far = std::max(far, s.range);
+      found = true;
+    }
+  }
+  return found;
+}
+
+void ProtectiveField::configure(uint32_t n, double first_angle, double last_angle, double scale)
+{
+  first_angle_ = first_angle;
+  last_angle_ = last_angle;
+  scale_ = scale;
+  near_.assign(n, 0);
+  far_.assign(n, 0);
+  if (n == 0 || scale <= 0)
+    return;
+  double increment = n > 1 ? (last_angle - first_angle) / (n - 1) : 0;
+  for (uint32_t i = 0; i < n; i++) {
+    double near, far;
+    if (!extent(first_angle + i * increment, near, far))
+      continue;
+    // r * scale in [near, far) for whole r; 0 and the out-of-range codes
+    // are never in it.
+    double lo = std::max(ceil(near / scale), 1.0);
+    double hi = std::min(ceil(far / scale), (double)PLS_MAX_VALID_RANGE + 1);
+    if (hi > lo) {
+      near_[i] = (uint32_t)lo;
+      far_[i] = (uint32_t)hi;
+    }
+  }
+}
+
+uint32_t ProtectiveField::check(const uint32_t *range_values, uint32_t n)
+{
+  // An empty scan has nothing inside, and no bins to point at
+  if (n == 0)
+    return 0;
+  if (n != far_.size())
+    configure(n, first_angle_, last_angle_, scale_);
+  const uint32_t *near = &near_[0], *far = &far_[0];
+  uint32_t inside = 0;
+  // near <= r < far as one unsigned compare; empty bins have far == near.
+  for (uint32_t i = 0; i < n; i++)
+    inside += (uint32_t)(range_values[i] - near[i]) < (uint32_t)(far[i] - near[i]);
+  return inside;
+}
+
+ProtectiveFieldSignal::ProtectiveFieldSignal()
+  : udp_fd_(-1), gpio_fd_(-1), sequence_(0), failures_(0)
+{
+}
+
+ProtectiveFieldSignal::~ProtectiveFieldSignal()
+{
+  close();
+}
+
+bool ProtectiveFieldSignal::open(const std::string &udp_target, const std::string &gpio_file)
+{
+  close();
+  bool ok = true;
+  if (!udp_target.empty()) {
+    size_t colon = udp_target.rfind(':');
+    struct addrinfo hints, *addresses = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    int err = colon == std::string::npos ? EAI_NONAME :
+      getaddrinfo(udp_target.substr(0, colon).c_str(), udp_target.substr(colon + 1).c_str(),
+                  &hints, &addresses);
+    if (err != 0) {
+      error_ = "couldn't resolve " + udp_target + " (expected host:port): " + gai_strerror(err);
+      ok = false;
+    }
+    else {
+      udp_fd_ = socket(addresses->ai_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (udp_fd_ < 0 || connect(udp_fd_, addresses->ai_addr, addresses->ai_addrlen) < 0) {
+        error_ = "couldn't set up UDP to " + udp_target + ": " + strerror(errno);
+        if (udp_fd_ >= 0)
+          ::close(udp_fd_);
+        udp_fd_ = -1;
+        ok = false;
+      }
+      freeaddrinfo(addresses);
+    }
+  }
+  if (!gpio_file.empty()) {
+    gpio_fd_ = ::open(gpio_file.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (gpio_fd_ < 0) {
+      error_ = "couldn't open " + gpio_file + ": " + strerror(errno);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+void ProtectiveFieldSignal::close()
+{
+  if (udp_fd_ >= 0)
+    ::close(udp_fd_);
+  if (gpio_fd_ >= 0)
+    ::close(gpio_fd_);
+  udp_fd_ = gpio_fd_ = -1;
+}
+
+bool ProtectiveFieldSignal::signal(bool intruded, uint64_t stamp_ns, uint32_t readings)
+{
+  bool ok = true;
+  // The pin first; it's what's wired to the brakes.
+  if (gpio_fd_ >= 0 && pwrite(gpio_fd_, intruded ? "1" : "0", 1, 0) != 1)
+    ok = false;
+  if (udp_fd_ >= 0) {
+    ProtectiveFieldPacket packet;
+    packet.magic = htole32(ProtectiveFieldPacket::MAGIC);
+    packet.sequence = htole32(sequence_);
+    packet.stamp_ns = htole64(stamp_ns);
+    packet.intruded = intruded;
+    memset(packet.reserved, 0, sizeof(packet.reserved));
+    packet.readings = htole32(readings);
+    if (send(udp_fd_, &packet, sizeof(packet), MSG_DONTWAIT) != (ssize_t)sizeof(packet))
+      ok = false;
+  }
+  sequence_++;
+  if (!ok)
+    failures_++;
+  return ok;
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,185 @@
+///////////////////////////////////////////////////////////////////////////////
+// scalar range conversion and the runtime selection of the fastest kernel
+// this machine supports.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include "range_kernels.h"
+#ifdef PLS_RANGE_KERNELS_X86
+#include <cpuid.h>
+#endif
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace sicktoolbox_pls_wrapper
+{
+
+RangeConverter range_converter_scalar(RangeUnits units, bool reverse, bool mask_out_of_range)
+{
+  return pick_converter<ScalarKernel>(units, reverse, mask_out_of_range);
+}
+
+RangeUnits range_units(double scale)
+{
+  if (fabs(scale - 0.01) < 1e-9)
+    return RANGE_UNITS_CM;
+  if (fabs(scale - 0.001) < 1e-9)
+    return RANGE_UNITS_MM;
+  return RANGE_UNITS_OTHER;
+}
+
+#ifdef PLS_RANGE_KERNELS_X86
+static bool cpu_has_avx2()
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  // The OS has to save the YMM registers for us (OSXSAVE + XCR0 bits 1,2).
+  if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+    return false;
+  unsigned int xcr0_lo, xcr0_hi;
+  __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  if ((xcr0_lo & 0x6) != 0x6)
+    return false;
+  if (__get_cpuid_max(0, 0) < 7)
+    return false;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return (ebx & (1 << 5)) != 0;
+}
+#endif
+
+// Probes the CPU for one instruction set. cpuid can trap to the hypervisor
+// and cost microseconds, so this only runs once per isa.
+static bool probe_kernel(RangeKernelIsa isa)
+{
+  switch (isa) {
+  case RANGE_KERNEL_SCALAR:
+    return true;
+#ifdef PLS_RANGE_KERNELS_X86
+  case RANGE_KERNEL_SSE2:
+#ifdef __x86_64__
+    return true;
+#else
+    {
+      unsigned int eax, ebx, ecx, edx;
+      return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2);
+    }
+#endif
+  case RANGE_KERNEL_AVX2:
+    return cpu_has_avx2();
+#endif
+#ifdef PLS_RANGE_KERNELS_ARM
+  case RANGE_KERNEL_NEON:
+#if defined(__aarch64__)
+    return true;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+    return false;
+#endif
+#endif
+  default:
+    return false;
+  }
+}
+
+bool range_kernel_available(RangeKernelIsa isa)
+{
+  static bool available[RANGE_KERNEL_COUNT];
+  static bool probed = false;
+  if (!probed) {
+    for (int i = 0; i < RANGE_KERNEL_COUNT; i++)
+      available[i] = probe_kernel((RangeKernelIsa)i);
+    probed = true; // benign if two threads race here; they compute the same table
+  }
+  return isa >= 0 && isa < RANGE_KERNEL_COUNT && available[isa];
+}
+
+RangeConverter select_range_converter(RangeKernelIsa isa, RangeUnits units, bool reverse,
+                                      bool mask_out_of_range)
+{
+  if (!range_kernel_available(isa))
+    return range_converter_scalar(units, reverse, mask_out_of_range);
+  switch (isa) {
+#ifdef PLS_RANGE_KERNELS_X86
+  case RANGE_KERNEL_SSE2:
+    return range_converter_sse2(units, reverse, mask_out_of_range);
+  case RANGE_KERNEL_AVX2:
+    return range_converter_avx2(units, reverse, mask_out_of_range);
+#endif
+#ifdef PLS_RANGE_KERNELS_ARM
+  case RANGE_KERNEL_NEON:
+    return range_converter_neon(units, reverse, mask_out_of_range);
+#endif
+  default:
+    return range_converter_scalar(units, reverse, mask_out_of_range);
+  }
+}
+
+RangeConverter select_range_converter(RangeUnits units, bool reverse, bool mask_out_of_range)
+{
+  return select_range_converter(selected_range_kernel(), units, reverse, mask_out_of_range);
+}
+
+RangeKernelIsa selected_range_kernel()
+{
+  static const RangeKernelIsa best =
+    range_kernel_available(RANGE_KERNEL_AVX2) ? RANGE_KERNEL_AVX2 :
+    range_kernel_available(RANGE_KERNEL_SSE2) ? RANGE_KERNEL_SSE2 :
+    range_kernel_available(RANGE_KERNEL_NEON) ? RANGE_KERNEL_NEON :
+    RANGE_KERNEL_SCALAR;
+  return best;
+}
+
+// Picks the kernel on every call, which is cheap but not free; anything
+// converting every scan the same way should hold on to a RangeConverter.
+void convert_ranges(const uint32_t *in, float *out, size_t n, float scale,
+                    bool reverse, bool mask_out_of_range)
+{
+  select_range_converter(RANGE_UNITS_OTHER, reverse, mask_out_of_range)(in, out, n, scale);
+}
+
+void convert_ranges(RangeKernelIsa isa, const uint32_t *in, float *out, size_t n,
+                    float scale, bool reverse, bool mask_out_of_range)
+{
+  select_range_converter(isa, RANGE_UNITS_OTHER, reverse, mask_out_of_range)(in, out, n, scale);
+}
+
+const char *range_kernel_name(RangeKernelIsa isa)
+{
+  switch (isa) {
+  case RANGE_KERNEL_SCALAR: return "scalar";
+  case RANGE_KERNEL_SSE2: return "sse2";
+  case RANGE_KERNEL_AVX2: return "avx2";
+  case RANGE_KERNEL_NEON: return "neon";
+  default: return "unknown";
+  }
+}
+
+} // namespace sicktoolbox_pls_wrapper
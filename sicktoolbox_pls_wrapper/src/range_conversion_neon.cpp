@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// NEON range conversion kernel. Built with -mfpu=neon on 32-bit ARM; NEON
+// is always there on aarch64.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "range_kernels.h"
+
+#ifdef PLS_RANGE_KERNELS_ARM
+#include <arm_neon.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+namespace
+{
+
+template <RangeUnits Units, bool Reverse, bool Mask>
+struct NeonKernel
+{
+  static void run(const uint32_t *in, float *out, size_t n, float scale)
+  {
+    const float s = UnitScale<Units>::get(scale);
+    const float32x4_t vinf = vdupq_n_f32(std::numeric_limits<float>::infinity());
+    const uint32x4_t vlimit = vdupq_n_u32(PLS_MAX_VALID_RANGE);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      uint32x4_t raw;
+      if (Reverse) {
+        raw = vrev64q_u32(vld1q_u32(in + n - 4 - i));
+        raw = vcombine_u32(vget_high_u32(raw), vget_low_u32(raw));
+      } else {
+        raw = vld1q_u32(in + i);
+      }
+      float32x4_t range = vmulq_n_f32(vcvtq_f32_u32(raw), s);
+      if (Mask)
+        range = vbslq_f32(vcgtq_u32(raw, vlimit), vinf, range);
+      vst1q_f32(out + i, range);
+    }
+    if (i < n) {
+      if (Reverse)
+        ScalarKernel<Units, true, Mask>::run(in, out + i, n - i, scale);
+      else
+        ScalarKernel<Units, false, Mask>::run(in + i, out + i, n - i, scale);
+    }
+  }
+};
+
+} // namespace
+
+RangeConverter range_converter_neon(RangeUnits units, bool reverse, bool mask_out_of_range)
+{
+  return pick_converter<NeonKernel>(units, reverse, mask_out_of_range);
+}
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// SSE2 range conversion kernel. Built with -msse2.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "range_kernels.h"
+
+#ifdef PLS_RANGE_KERNELS_X86
+#include <emmintrin.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+namespace
+{
+
+template <RangeUnits Units, bool Reverse, bool Mask>
+struct Sse2Kernel
+{
+  static void run(const uint32_t *in, float *out, size_t n, float scale)
+  {
+    const __m128 vscale = _mm_set1_ps(UnitScale<Units>::get(scale));
+    const __m128 vinf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    const __m128i vlimit = _mm_set1_epi32(PLS_MAX_VALID_RANGE);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      __m128i raw;
+      if (Reverse) {
+        raw = _mm_loadu_si128((const __m128i *)(in + n - 4 - i));
+        raw = _mm_shuffle_epi32(raw, _MM_SHUFFLE(0, 1, 2, 3));
+      } else {
+        raw = _mm_loadu_si128((const __m128i *)(in + i));
+      }
+      // Readings fit in 16 bits, so the signed conversion and compare are exact.
+      __m128 range = _mm_mul_ps(_mm_cvtepi32_ps(raw), vscale);
+      if (Mask) {
+        __m128 bad = _mm_castsi128_ps(_mm_cmpgt_epi32(raw, vlimit));
+        range = _mm_or_ps(_mm_and_ps(bad, vinf), _mm_andnot_ps(bad, range));
+      }
+      _mm_storeu_ps(out + i, range);
+    }
+    if (i < n) {
+      if (Reverse)
+        ScalarKernel<Units, true, Mask>::run(in, out + i, n - i, scale);
+      else
+        ScalarKernel<Units, false, Mask>::run(in + i, out + i, n - i, scale);
+    }
+  }
+};
+
+} // namespace
+
+RangeConverter range_converter_sse2(RangeUnits units, bool reverse, bool mask_out_of_range)
+{
+  return pick_converter<Sse2Kernel>(units, reverse, mask_out_of_range);
+}
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
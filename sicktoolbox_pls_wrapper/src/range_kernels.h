@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// kernel templates and entry points shared between range_conversion.cpp
+// and the per-instruction-set translation units, each built with its own
+// target flags. Not installed.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SICKTOOLBOX_PLS_WRAPPER_RANGE_KERNELS_H
+#define SICKTOOLBOX_PLS_WRAPPER_RANGE_KERNELS_H
+
+#include <limits>
+#include <sicktoolbox_pls_wrapper/range_conversion.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PLS_RANGE_KERNELS_X86 1
+#endif
+#if defined(__aarch64__) || defined(__arm__)
+#define PLS_RANGE_KERNELS_ARM 1
+#endif
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Each kernel translation unit picks from the instantiations of its own
+// Kernel<Units, Reverse, Mask>::run; RANGE_UNITS_OTHER is the one behind
+// convert_ranges().
+RangeConverter range_converter_scalar(RangeUnits units, bool reverse, bool mask_out_of_range);
+#ifdef PLS_RANGE_KERNELS_X86
+RangeConverter range_converter_sse2(RangeUnits units, bool reverse, bool mask_out_of_range);
+RangeConverter range_converter_avx2(RangeUnits units, bool reverse, bool mask_out_of_range);
+#endif
+#ifdef PLS_RANGE_KERNELS_ARM
+RangeConverter range_converter_neon(RangeUnits units, bool reverse, bool mask_out_of_range);
+#endif
+
+// Everything below is instantiated in each kernel's translation unit with
+// that unit's target flags, so it must never be shared between them at
+// link time: an AVX2 copy of the scalar tail picked by the linker for the
+// scalar kernel would fault on older CPUs.
+namespace
+{
+
+template <RangeUnits Units>
+struct UnitScale
+{
+  static float get(float scale) { return scale; }
+};
+
+template <>
+struct UnitScale<RANGE_UNITS_CM>
+{
+  static float get(float) { return 0.01f; }
+};
+
+template <>
+struct UnitScale<RANGE_UNITS_MM>
+{
+  static float get(float) { return 0.001f; }
+};
+
+// Also the tail of the vector kernels, for the readings after the last
+// whole vector (with Reverse, the first readings of in).
+template <RangeUnits Units, bool Reverse, bool Mask>
+struct ScalarKernel
+{
+  static void run(const uint32_t *in, float *out, size_t n, float scale)
+  {
+    const float s = UnitScale<Units>::get(scale);
+    const float inf = std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < n; i++) {
+      uint32_t raw = Reverse ? in[n - 1 - i] : in[i];
+      float range = (float)raw * s;
+      out[i] = (Mask && raw > PLS_MAX_VALID_RANGE) ? inf : range;
+    }
+  }
+};
+
+template <template <RangeUnits, bool, bool> class Kernel, RangeUnits Units>
+RangeConverter pick_modes(bool reverse, bool mask_out_of_range)
+{
+  if (reverse)
+    return mask_out_of_range ? &Kernel<Units, true, true>::run : &Kernel<Units, true, false>::run;
+  return mask_out_of_range ? &Kernel<Units, false, true>::run : &Kernel<Units, false, false>::run;
+}
+
+template <template <RangeUnits, bool, bool> class Kernel>
+RangeConverter pick_converter(RangeUnits units, bool reverse, bool mask_out_of_range)
+{
+  switch (units) {
+  case RANGE_UNITS_CM:
+    return pick_modes<Kernel, RANGE_UNITS_CM>(reverse, mask_out_of_range);
+  case RANGE_UNITS_MM:
+    return pick_modes<Kernel, RANGE_UNITS_MM>(reverse, mask_out_of_range);
+  default:
+    return pick_modes<Kernel, RANGE_UNITS_OTHER>(reverse, mask_out_of_range);
+  }
+}
+
+} // namespace
+
+} // namespace sicktoolbox_pls_wrapper
+
+#endif
@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////////////
+// CPU affinity, SCHED_FIFO and memory locking for the driver's threads.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sicktoolbox_pls_wrapper/realtime.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+pid_t current_thread_id()
+{
+  return syscall(SYS_gettid);
+}
+
+std::vector<pid_t> process_thread_ids()
+{
+  std::vector<pid_t> tids;
+  DIR *dir = opendir("/proc/self/task");
+  if (!dir)
+    return tids;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9')
+      tids.push_back(atoi(entry->d_name));
+  }
+  closedir(dir);
+  std::sort(tids.begin(), tids.end());
+  return tids;
+}
+
+bool parse_cpu_list(const std::string &list, std::vector<int> &cpus)
+{
+  cpus.clear();
+  const char *p = list.c_str();
+  while (*p) {
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p || first < 0 || first >= CPU_SETSIZE)
+      return false;
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol(p + 1, &end, 10);
+      if (end == p + 1 || last < first || last >= CPU_SETSIZE)
+        return false;
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+    if (*p == ',')
+      p++;
+    else if (*p)
+      return false;
+  }
+  return !cpus.empty();
+}
+
+std::string ThreadTuning::describe() const
+{
+  std::string description = realtime ? "SCHED_FIFO" : "SCHED_OTHER";
+  char buf[32];
+  if (realtime) {
+    snprintf(buf, sizeof(buf), " %d", priority);
+    description += buf;
+  }
+  if (affinity_set) {
+    description += cpus.size() == 1 ? " on CPU " : " on CPUs ";
+    for (size_t i = 0; i < cpus.size(); i++) {
+      snprintf(buf, sizeof(buf), i ? ",%d" : "%d", cpus[i]);
+      description += buf;
+    }
+  }
+  if (!error.empty())
+    description += " (" + error + ")";
+  return description;
+}
+
+ThreadTuning tune_thread(pid_t tid, const std::vector<int> &cpus, int priority)
+{
+  ThreadTuning tuning;
+  tuning.tid = tid;
+  tuning.cpus = cpus;
+  tuning.priority = priority;
+
+  if (!cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus.size(); i++)
+      CPU_SET(cpus[i], &set);
+    if (sched_setaffinity(tid, sizeof(set), &set) == 0)
+      tuning.affinity_set = true;
+    else
+      tuning.error = std::string("affinity: ") + strerror(errno);
+  }
+
+  if (priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = std::min(priority, sched_get_priority_max(SCHED_FIFO));
+    if (sched_setscheduler(tid, SCHED_FIFO, &param) != 0) {
+      if (!tuning.error.empty())
+        tuning.error += ", ";
+      tuning.error += std::string("SCHED_FIFO: ") + strerror(errno);
+    }
+    // Believe the kernel rather than the return code
+    tuning.realtime = sched_getscheduler(tid) == SCHED_FIFO;
+    if (tuning.realtime && sched_getparam(tid, &param) == 0)
+      tuning.priority = param.sched_priority;
+  }
+  return tuning;
+}
+
+bool lock_memory(std::string &error)
+{
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+    return true;
+  error = strerror(errno);
+  return false;
+}
+
+void prefault_stack(size_t bytes)
+{
+  char *stack = static_cast<char *>(alloca(bytes));
+  // volatile so that the compiler can't drop the writes
+  for (size_t i = 0; i < bytes; i += 4096)
+    static_cast<volatile char *>(stack)[i] = 0;
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+// delta compression of raw PLS scans.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/scan_delta.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+static inline void put_varint(std::vector<uint8_t> &data, uint32_t v)
+{
+  while (v >= 0x80) {
+    data.push_back((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  data.push_back((uint8_t)v);
+}
+
+static inline void put_signed(std::vector<uint8_t> &data, int32_t v)
+{
+  put_varint(data, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+// Returns false at the end of the data or on an overlong varint.
+static inline bool get_varint(const uint8_t *&p, const uint8_t *end, uint32_t &v)
+{
+  v = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (p == end)
+      return false;
+    uint8_t b = *p++;
+    v |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static inline bool get_signed(const uint8_t *&p, const uint8_t *end, int32_t &v)
+{
+  uint32_t u;
+  if (!get_varint(p, end, u))
+    return false;
+  v = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+  return true;
+}
+
+ScanDeltaEncoder::ScanDeltaEncoder(uint32_t keyframe_interval, uint32_t deadband)
+  : keyframe_interval_(keyframe_interval ? keyframe_interval : 1), deadband_(deadband),
+    since_keyframe_(0), frame_(0), keyframe_requested_(true)
+{
+}
+
+// Each reading as the zigzag difference from the one before it.
+static void encode_keyframe(const uint32_t *range_values, uint32_t n, std::vector<uint8_t> &data)
+{
+  uint32_t previous = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    put_signed(data, (int32_t)(range_values[i] - previous));
+    previous = range_values[i];
+  }
+}
+
+static inline bool within(uint32_t a, uint32_t b, uint32_t deadband)
+{
+  return (a > b ? a - b : b - a) <= deadband;
+}
+
+ScanDeltaFrame ScanDeltaEncoder::encode(const uint32_t *range_values, uint32_t n,
+                                        std::vector<uint8_t> &data)
+{
+  data.clear();
+  bool keyframe = keyframe_requested_ || n != reference_.size() ||
+    since_keyframe_ + 1 >= keyframe_interval_;
+  if (keyframe) {
+    encode_keyframe(range_values, n, data);
+  }
+  else {
+    if (!encodeDelta(range_values, n, data)) {
+      since_keyframe_++;
+      return SCAN_DELTA_UNCHANGED;
+    }
+    // A scene that moved everywhere codes better from one reading to the
+    // next than against the last frame, and a keyframe resyncs for free.
+    if (data.size() > n) {
+      keyframe_.clear();
+      encode_keyframe(range_values, n, keyframe_);
+      keyframe = keyframe_.size() <= data.size();
+      if (keyframe)
+        data.swap(keyframe_);
+    }
+  }
+
+  frame_++;
+  if (!keyframe) {
+    since_keyframe_++;
+    return SCAN_DELTA_DELTA;
+  }
+  reference_.assign(range_values, range_values + n);
+  since_keyframe_ = 0;
+  keyframe_requested_ = false;
+  return SCAN_DELTA_KEYFRAME;
+}
+
+bool ScanDeltaEncoder::encodeDelta(const uint32_t *range_values, uint32_t n,
+                                   std::vector<uint8_t> &data)
+{
+  // Nothing to code against, and no first reading to take the address of
+  if (n == 0)
+    return false;
+  uint32_t *reference = &reference_[0];
+  uint32_t unchanged_from = 0; // first reading after the last run written
+  uint32_t i = 0;
+  while (i < n) {
+    if (within(range_values[i], reference[i], deadband_)) {
+      i++;
+      continue;
+    }
+    uint32_t end = i + 1;
+    while (end < n && !within(range_values[end], reference[end], deadband_))
+      end++;
+    put_varint(data, i - unchanged_from);
+    put_varint(data, end - i);
+    for (; i < end; i++) {
+      put_signed(data, (int32_t)(range_values[i] - reference[i]));
+      reference[i] = range_values[i];
+    }
+    unchanged_from = end;
+  }
+  return !data.empty();
+}
+
+ScanDeltaDecoder::ScanDeltaDecoder()
+  : frame_(0), synchronized_(false), dropped_(0)
+{
+}
+
+bool ScanDeltaDecoder::decode(bool keyframe, uint32_t frame, uint32_t n,
+                              const uint8_t *data, size_t size)
+{
+  const uint8_t *p = data;
+  const uint8_t *end = data + size;
+  if (keyframe) {
+    values_.resize(n);
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      int32_t d;
+      if (!get_signed(p, end, d)) {
+        synchronized_ = false;
+        dropped_++;
+        return false;
+      }
+      previous += d;
+      values_[i] = previous;
+    }
+    frame_ = frame;
+    synchronized_ = true;
+    return true;
+  }
+
+  if (!synchronized_ || frame != frame_ + 1 || n != values_.size()) {
+    synchronized_ = false;
+    dropped_++;
+    return false;
+  }
+  uint32_t i = 0;
+  while (p != end) {
+    uint32_t skip, count;
+    if (!get_varint(p, end, skip) || !get_varint(p, end, count) ||
+        skip > n - i || count > n - i - skip) {
+      synchronized_ = false;
+      dropped_++;
+      return false;
+    }
+    i += skip;
+    for (uint32_t k = 0; k < count; k++, i++) {
+      int32_t d;
+      if (!get_signed(p, end, d)) {
+        synchronized_ = false;
+        dropped_++;
+        return false;
+      }
+      values_[i] += d;
+    }
+  }
+  frame_ = frame;
+  return true;
+}
+
+} // namespace sicktoolbox_pls_wrapper
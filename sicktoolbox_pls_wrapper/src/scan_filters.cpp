@@ -0,0 +1,249 @@
+///////////////////////////////////////////////////////////////////////////////
+// filters that run on raw PLS readings before they're published.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/scan_filters.h>
+#include <sicktoolbox_pls_wrapper/range_conversion.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// Helpers for the short sorted runs the medians keep.
+
+static inline void insert_sorted(uint32_t *sorted, uint32_t count, uint32_t value)
+{
+  uint32_t j = count;
+  while (j > 0 && sorted[j - 1] > value) {
+    sorted[j] = sorted[j - 1];
+    j--;
+  }
+  sorted[j] = value;
+}
+
+static inline void remove_sorted(uint32_t *sorted, uint32_t count, uint32_t value)
+{
+  uint32_t j = 0;
+  while (j < count - 1 && sorted[j] != value)
+    j++;
+  for (; j < count - 1; j++)
+    sorted[j] = sorted[j + 1];
+}
+
+// Swaps old_value for value and moves it to where it belongs.
+static inline void replace_sorted(uint32_t *sorted, uint32_t count, uint32_t old_value, uint32_t value)
+{
+  uint32_t j = 0;
+  while (j < count - 1 && sorted[j] != old_value)
+    j++;
+  while (j > 0 && sorted[j - 1] > value) {
+    sorted[j] = sorted[j - 1];
+    j--;
+  }
+  while (j < count - 1 && sorted[j + 1] < value) {
+    sorted[j] = sorted[j + 1];
+    j++;
+  }
+  sorted[j] = value;
+}
+
+// Branch-free medians for the common windows, as min/max exchange networks
+// (Devillard's opt_med3 and opt_med5). Noisy readings make the sorted-run
+// updates mispredict on nearly every step; these compile to cmovs.
+
+static inline void exchange(uint32_t &a, uint32_t &b)
+{
+  // Written so that GCC emits one cmov rather than a branch around a swap.
+  uint32_t lo = b < a ? b : a;
+  b ^= a ^ lo;
+  a = lo;
+}
+
+static inline uint32_t median3(uint32_t a, uint32_t b, uint32_t c)
+{
+  exchange(a, b);
+  exchange(b, c);
+  exchange(a, b);
+  return b;
+}
+
+static inline uint32_t median5(const uint32_t *v)
+{
+  uint32_t p0 = v[0], p1 = v[1], p2 = v[2], p3 = v[3], p4 = v[4];
+  exchange(p0, p1);
+  exchange(p3, p4);
+  exchange(p0, p3);
+  exchange(p1, p4);
+  exchange(p1, p2);
+  exchange(p2, p3);
+  exchange(p1, p2);
+  return p2;
+}
+
+TemporalMedianFilter::TemporalMedianFilter(uint32_t window, uint32_t max_values)
+  : window_(window ? window : 1), max_values_(max_values),
+    arrivals_(window_ * max_values), sorted_(window_ * max_values)
+{
+  reset();
+}
+
+void TemporalMedianFilter::reset()
+{
+  n_ = 0;
+  count_ = 0;
+  next_ = 0;
+}
+
+void TemporalMedianFilter::apply(uint32_t *values, uint32_t n)
+{
+  if (n > max_values_)
+    n = max_values_;
+  if (n != n_) {
+    reset();
+    n_ = n;
+  }
+  bool full = count_ == window_;
+  uint32_t count = full ? count_ : count_ + 1;
+  if (full && (window_ == 3 || window_ == 5)) {
+    // The networks work on the arrivals directly; sorted_ only matters again
+    // after a reset, which refills it from scratch.
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t *arrivals = &arrivals_[i * window_];
+      arrivals[next_] = values[i];
+      values[i] = window_ == 3 ? median3(arrivals[0], arrivals[1], arrivals[2]) : median5(arrivals);
+    }
+    next_ = next_ + 1 == window_ ? 0 : next_ + 1;
+    return;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t *arrivals = &arrivals_[i * window_];
+    uint32_t *sorted = &sorted_[i * window_];
+    if (full)
+      replace_sorted(sorted, count, arrivals[next_], values[i]);
+    else
+      insert_sorted(sorted, count_, values[i]);
+    arrivals[next_] = values[i];
+    values[i] = sorted[count / 2];
+  }
+  count_ = count;
+  next_ = next_ + 1 == window_ ? 0 : next_ + 1;
+}
+
+SpatialMedianFilter::SpatialMedianFilter(uint32_t window, uint32_t max_values)
+  : half_(window / 2), input_(max_values + window + 1)
+{
+}
+
+void SpatialMedianFilter::apply(uint32_t *values, uint32_t n)
+{
+  if (n == 0 || half_ == 0)
+    return;
+  n = std::min<uint32_t>(n, input_.size() - 2 * half_ - 1);
+  // The input goes at the front of input_ and the sorted window behind it.
+  uint32_t *input = &input_[0];
+  uint32_t *sorted = input + n;
+  memcpy(input, values, n * sizeof(uint32_t));
+
+  if ((half_ == 1 || half_ == 2) && n > 2 * half_) {
+    // Networks in the middle, where the window is whole; the short windows
+    // at the ends take their median the same way as below.
+    for (uint32_t i = half_; i + half_ < n; i++)
+      values[i] = half_ == 1 ? median3(input[i - 1], input[i], input[i + 1]) : median5(input + i - 2);
+    for (uint32_t e = 0; e < half_; e++) {
+      uint32_t count = 0;
+      for (uint32_t k = 0; k <= e + half_; k++)
+        insert_sorted(sorted, count++, input[k]);
+      values[e] = sorted[count / 2];
+      count = 0;
+      for (uint32_t k = n - 1 - e - half_; k < n; k++)
+        insert_sorted(sorted, count++, input[k]);
+      values[n - 1 - e] = sorted[count / 2];
+    }
+    return;
+  }
+
+  // The window around reading 0 is readings 0..half_; each step adds the
+  // reading half_ + 1 ahead and drops the one half_ behind, while they exist.
+  uint32_t count = 0;
+  for (uint32_t k = 0; k <= half_ && k < n; k++)
+    insert_sorted(sorted, count++, input[k]);
+  for (uint32_t i = 0; i < n; i++) {
+    values[i] = sorted[count / 2];
+    uint32_t enter = i + half_ + 1;
+    bool leaves = i >= half_;
+    if (enter < n && leaves) {
+      replace_sorted(sorted, count, input[i - half_], input[enter]);
+    }
+    else if (enter < n) {
+      insert_sorted(sorted, count++, input[enter]);
+    }
+    else if (leaves) {
+      remove_sorted(sorted, count--, input[i - half_]);
+    }
+  }
+}
+
+ShadowFilter::ShadowFilter(double min_angle, double max_angle, uint32_t window,
+                           double angle_increment, uint32_t max_values)
+  : window_(window ? window : 1), sin_min_(sin(min_angle)), cos_min_(cos(min_angle)),
+    sin_max_(sin(max_angle)), cos_max_(cos(max_angle)), sin_step_(window_ + 1),
+    cos_step_(window_ + 1), input_(max_values)
+{
+  for (uint32_t k = 1; k <= window_; k++) {
+    sin_step_[k] = sin(k * angle_increment);
+    cos_step_[k] = cos(k * angle_increment);
+  }
+}
+
+void ShadowFilter::apply(uint32_t *values, uint32_t n)
+{
+  n = std::min<uint32_t>(n, input_.size());
+  uint32_t *input = &input_[0];
+  memcpy(input, values, n * sizeof(uint32_t));
+  for (uint32_t i = 0; i < n; i++) {
+    double r1 = input[i];
+    if (input[i] == 0 || input[i] > PLS_MAX_VALID_RANGE)
+      continue;
+    for (uint32_t k = 1; k <= window_ && i + k < n; k++) {
+      uint32_t j = i + k;
+      if (input[j] == 0 || input[j] > PLS_MAX_VALID_RANGE)
+        continue;
+      // The angle at reading i between the line of sight and the line to
+      // reading j is atan2(y, x). y is always positive, so comparing it with
+      // an angle a in (0, pi) only takes x sin(a) against y cos(a).
+      double r2 = input[j];
+      double y = r2 * sin_step_[k];
+      double x = r1 - r2 * cos_step_[k];
+      if (x * sin_min_ > y * cos_min_ || x * sin_max_ < y * cos_max_)
+        values[input[i] > input[j] ? i : j] = SCAN_FILTER_REMOVED;
+    }
+  }
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+// the last few seconds of scans, kept for lookups by time.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/scan_history.h>
+#include <cstdlib>
+#include <new>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+namespace
+{
+
+// Holds a pthread mutex for the life of a scope.
+class Lock : boost::noncopyable
+{
+public:
+  explicit Lock(pthread_mutex_t &mutex) : mutex_(mutex) { pthread_mutex_lock(&mutex_); }
+  ~Lock() { pthread_mutex_unlock(&mutex_); }
+
+private:
+  pthread_mutex_t &mutex_;
+};
+
+} // namespace
+
+ScanHistory::ScanHistory(size_t capacity)
+  : scans_(NULL), stamps_(NULL), capacity_(0), first_(0), size_(0), added_(0), restarts_(0)
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+  pthread_mutex_init(&mutex_, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  void *block = NULL;
+  if (capacity == 0 || posix_memalign(&block, PlsScan::CACHE_LINE, capacity * sizeof(PlsScan)) != 0) {
+    pthread_mutex_destroy(&mutex_);
+    throw std::bad_alloc();
+  }
+  scans_ = static_cast<PlsScan *>(block);
+  stamps_ = new uint64_t[capacity];
+  capacity_ = capacity;
+  for (size_t i = 0; i < capacity; i++)
+    new (scans_ + i) PlsScan;
+}
+
+ScanHistory::~ScanHistory()
+{
+  // PlsScan has nothing to destroy
+  free(scans_);
+  delete[] stamps_;
+  pthread_mutex_destroy(&mutex_);
+}
+
+size_t ScanHistory::size()
+{
+  Lock lock(mutex_);
+  return size_;
+}
+
+void ScanHistory::add(const PlsScan &scan, uint64_t stamp_ns)
+{
+  Lock lock(mutex_);
+  if (size_ > 0 && stamp_ns < stamps_[slot(size_ - 1)]) {
+    first_ = 0;
+    size_ = 0;
+    restarts_++;
+  }
+  size_t i;
+  if (size_ < capacity_) {
+    i = slot(size_);
+    size_++;
+  }
+  else {
+    // Full: the newest takes the place of the oldest
+    i = first_;
+    first_ = (first_ + 1) % capacity_;
+  }
+  scans_[i].assign(scan);
+  stamps_[i] = stamp_ns;
+  added_++;
+}
+
+void ScanHistory::clear()
+{
+  Lock lock(mutex_);
+  first_ = 0;
+  size_ = 0;
+}
+
+size_t ScanHistory::countUpTo(uint64_t stamp_ns) const
+{
+  size_t begin = 0;
+  size_t end = size_;
+  while (begin < end) {
+    size_t mid = begin + (end - begin) / 2;
+    if (stamps_[slot(mid)] <= stamp_ns)
+      begin = mid + 1;
+    else
+      end = mid;
+  }
+  return begin;
+}
+
+void ScanHistory::visitRange(size_t begin, size_t end, const Visitor &visit) const
+{
+  for (size_t i = begin; i < end; i++)
+    visit(scans_[slot(i)], stamps_[slot(i)]);
+}
+
+size_t ScanHistory::nearest(uint64_t stamp_ns, const Visitor &visit)
+{
+  Lock lock(mutex_);
+  if (size_ == 0)
+    return 0;
+  size_t after = countUpTo(stamp_ns);
+  size_t i;
+  if (after == 0)
+    i = 0;
+  else if (after == size_)
+    i = size_ - 1;
+  else
+    i = stamp_ns - stamps_[slot(after - 1)] <= stamps_[slot(after)] - stamp_ns ? after - 1 : after;
+  visitRange(i, i + 1, visit);
+  return 1;
+}
+
+size_t ScanHistory::bracket(uint64_t stamp_ns, const Visitor &visit)
+{
+  Lock lock(mutex_);
+  if (size_ == 0)
+    return 0;
+  size_t after = countUpTo(stamp_ns);
+  size_t begin = after > 0 ? after - 1 : 0;
+  size_t end = after < size_ ? after + 1 : size_;
+  visitRange(begin, end, visit);
+  return end - begin;
+}
+
+size_t ScanHistory::latest(size_t n, const Visitor &visit)
+{
+  Lock lock(mutex_);
+  size_t count = n < size_ ? n : size_;
+  visitRange(size_ - count, size_, visit);
+  return count;
+}
+
+bool ScanHistory::span(uint64_t &oldest_ns, uint64_t &newest_ns)
+{
+  Lock lock(mutex_);
+  if (size_ == 0)
+    return false;
+  oldest_ns = stamps_[slot(0)];
+  newest_ns = stamps_[slot(size_ - 1)];
+  return true;
+}
+
+} // namespace sicktoolbox_pls_wrapper
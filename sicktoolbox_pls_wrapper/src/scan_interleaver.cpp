@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// merges interleaved partial scans into one full-resolution scan.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/scan_interleaver.h>
+#include <algorithm>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+ScanInterleaver::ScanInterleaver(uint32_t factor, uint32_t max_values)
+  : factor_(std::max(factor, 1u)), max_values_(max_values), max_gap_ns_(0), phase_(0), n_(0),
+    last_ns_(0), stamp_ns_(0), size_(0), merged_(max_values ? (max_values - 1) * factor_ + 1 : 0),
+    merged_count_(0), broken_count_(0)
+{
+}
+
+void ScanInterleaver::reset()
+{
+  if (phase_ > 0)
+    broken_count_++;
+  phase_ = 0;
+  size_ = 0;
+}
+
+bool ScanInterleaver::add(const uint32_t *values, uint32_t n, uint64_t stamp_ns)
+{
+  if (n > max_values_)
+    n = max_values_;
+  if (n == 0)
+    return false;
+  if (phase_ > 0 && (n != n_ || (max_gap_ns_ && stamp_ns - last_ns_ > max_gap_ns_)))
+    reset();
+  last_ns_ = stamp_ns;
+  if (phase_ == 0) {
+    n_ = n;
+    stamp_ns_ = stamp_ns;
+    size_ = 0;
+  }
+
+  // The first scan of a set has the last reading to itself.
+  uint32_t *out = &merged_[phase_];
+  uint32_t count = phase_ == 0 ? n : n - 1;
+  for (uint32_t i = 0; i < count; i++)
+    out[i * factor_] = values[i];
+
+  if (++phase_ < factor_)
+    return false;
+  phase_ = 0;
+  size_ = (n - 1) * factor_ + 1;
+  merged_count_++;
+  return true;
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// projection of raw PLS readings to points in the scan plane.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <sicktoolbox_pls_wrapper/range_conversion.h>
+#include <sicktoolbox_pls_wrapper/scan_projection.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sicktoolbox_pls_wrapper
+{
+
+ScanProjector::ScanProjector()
+{
+}
+
+void ScanProjector::configure(uint32_t n_range_values, float angle_min, float angle_increment)
+{
+  cos_.resize(n_range_values);
+  sin_.resize(n_range_values);
+  for (uint32_t i = 0; i < n_range_values; i++) {
+    double angle = angle_min + (double)i * angle_increment;
+    cos_[i] = cos(angle);
+    sin_[i] = sin(angle);
+  }
+}
+
+uint32_t ScanProjector::project(const uint32_t *range_values, uint32_t n_range_values, float scale,
+                                bool dense, float *points) const
+{
+  const uint32_t n = std::min<uint32_t>(n_range_values, cos_.size());
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  float *out = points;
+  uint32_t i = 0;
+
+#if defined(__SSE2__)
+  // Four readings at a time, transposed into four points. Every point is
+  // stored; a dense cloud just doesn't advance past the invalid ones.
+  const __m128 scale4 = _mm_set1_ps(scale);
+  const __m128i max_valid = _mm_set1_epi32(PLS_MAX_VALID_RANGE);
+  const __m128 nan4 = _mm_set1_ps(nan);
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4) {
+    __m128i raw = _mm_loadu_si128((const __m128i *)(range_values + i));
+    __m128 invalid = _mm_castsi128_ps(_mm_cmpgt_epi32(raw, max_valid));
+    __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(raw), scale4);
+    __m128 x = _mm_mul_ps(r, _mm_loadu_ps(&cos_[i]));
+    __m128 y = _mm_mul_ps(r, _mm_loadu_ps(&sin_[i]));
+    __m128 z = zero;
+    if (!dense) {
+      x = _mm_or_ps(_mm_andnot_ps(invalid, x), _mm_and_ps(invalid, nan4));
+      y = _mm_or_ps(_mm_andnot_ps(invalid, y), _mm_and_ps(invalid, nan4));
+      z = _mm_and_ps(invalid, nan4);
+    }
+    __m128 xy_lo = _mm_unpacklo_ps(x, y);
+    __m128 xy_hi = _mm_unpackhi_ps(x, y);
+    __m128 z_lo = _mm_unpacklo_ps(z, zero);
+    __m128 z_hi = _mm_unpackhi_ps(z, zero);
+    int keep = dense ? ~_mm_movemask_ps(invalid) : 0xf;
+    _mm_storeu_ps(out, _mm_movelh_ps(xy_lo, z_lo));
+    out += (keep & 1) * 4;
+    _mm_storeu_ps(out, _mm_movehl_ps(z_lo, xy_lo));
+    out += (keep >> 1 & 1) * 4;
+    _mm_storeu_ps(out, _mm_movelh_ps(xy_hi, z_hi));
+    out += (keep >> 2 & 1) * 4;
+    _mm_storeu_ps(out, _mm_movehl_ps(z_hi, xy_hi));
+    out += (keep >> 3 & 1) * 4;
+  }
+#endif
+
+  for (; i < n; i++) {
+    bool invalid = range_values[i] > PLS_MAX_VALID_RANGE;
+    if (invalid && dense)
+      continue;
+    float r = range_values[i] * scale;
+    out[0] = invalid ? nan : r * cos_[i];
+    out[1] = invalid ? nan : r * sin_[i];
+    out[2] = invalid ? nan : 0;
+    out[3] = 0;
+    out += 4;
+  }
+  return (out - points) / 4;
+}
+
+} // namespace sicktoolbox_pls_wrapper
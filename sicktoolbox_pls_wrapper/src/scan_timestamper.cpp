@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+// minimum-delay filtering of PLS scan timestamps.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sicktoolbox_pls_wrapper/scan_timestamper.h>
+#include <math.h>
+
+namespace sicktoolbox_pls_wrapper
+{
+
+// STX, address, 2 length bytes, command, 2 count bytes, 2 bytes per reading,
+// status, 2 CRC bytes.
+static const uint32_t TELEGRAM_OVERHEAD_BYTES = 10;
+// 8N1 framing: start bit, 8 data bits, stop bit.
+static const uint32_t BITS_PER_BYTE = 10;
+
+// How far a late frame moves the estimate. Early frames always move it all
+// the way.
+static const double PHASE_GAIN = 0.05;
+// Fraction of a period an arrival may come before its grid point.
+static const double GRID_TOLERANCE = 0.25;
+// Seconds of envelope the period is measured over.
+static const double MIN_BASELINE = 2.0;
+static const double MAX_BASELINE = 60.0;
+// A gap longer than this between reads means we lost sync.
+static const double MAX_GAP = 1.0;
+
+ScanTimestamper::ScanTimestamper(double scan_time, uint32_t baud)
+  : scan_time_(scan_time), baud_(baud), resets_(0)
+{
+  reset();
+  resets_ = 0;
+}
+
+double ScanTimestamper::transferTime(uint32_t baud, uint32_t n_range_values)
+{
+  if (baud == 0)
+    return 0;
+  return (double)(TELEGRAM_OVERHEAD_BYTES + 2 * n_range_values) * BITS_PER_BYTE / baud;
+}
+
+double ScanTimestamper::framePeriod(double scan_time, uint32_t baud, uint32_t n_range_values)
+{
+  double scans = ceil(transferTime(baud, n_range_values) / scan_time - 1e-6);
+  return (scans < 1 ? 1 : scans) * scan_time;
+}
+
+void ScanTimestamper::reset()
+{
+  locked_ = false;
+  predicted_ = 0;
+  period_ = 0;
+  mean_delay_ = 0;
+  frames_ = 0;
+  anchor_time_ = 0;
+  anchor_frames_ = 0;
+  resets_++;
+}
+
+double ScanTimestamper::stamp(double read_return_time, uint32_t n_range_values)
+{
+  double first_byte = read_return_time - transferTime(baud_, n_range_values);
+
+  if (locked_) {
+    double since = first_byte - predicted_;
+    // Before the last grid point, or after a long outage: either way the
+    // grid we were tracking is gone.
+    if (since < -period_ || since > MAX_GAP)
+      reset();
+  }
+
+  if (!locked_) {
+    locked_ = true;
+    predicted_ = first_byte;
+    period_ = framePeriod(scan_time_, baud_, n_range_values);
+    anchor_time_ = first_byte;
+  } else {
+    // Frames may have been skipped; work out which grid point this is.
+    // Delays are never negative, so it's the last one at or before the
+    // arrival, give or take the envelope sitting a little high.
+    double frames = floor((first_byte - predicted_) / period_ + GRID_TOLERANCE);
+    if (frames < 0)
+      frames = 0;
+    double expected = predicted_ + frames * period_;
+    double error = first_byte - expected;
+    frames_ += (unsigned long)frames;
+    if (error < 0) {
+      predicted_ = first_byte;
+    } else {
+      predicted_ = expected + PHASE_GAIN * error;
+      mean_delay_ += 0.01 * (error - mean_delay_);
+    }
+
+    // Measure the period over a long baseline of envelope points, which
+    // averages out where on the envelope each end happens to sit. The
+    // baseline restarts now and then to follow slow changes in drift.
+    double baseline = predicted_ - anchor_time_;
+    // Re-seeding on an early frame can stretch the baseline before any
+    // frame has been counted on it.
+    if (baseline > MIN_BASELINE && frames_ > anchor_frames_)
+      period_ = baseline / (frames_ - anchor_frames_);
+    if (baseline > MAX_BASELINE) {
+      anchor_time_ = predicted_;
+      anchor_frames_ = frames_;
+    }
+  }
+
+  // A frame can't have started arriving after we saw it start. This only
+  // matters for frames so late they were counted against the next grid
+  // point.
+  double estimate = predicted_ < first_byte ? predicted_ : first_byte;
+
+  // The telegram goes out once the mirror has swept the 180 degree field,
+  // which is half of its rotation.
+  return estimate - scan_time_ / 2.0;
+}
+
+} // namespace sicktoolbox_pls_wrapper
@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////
+// times the range conversion kernels against the per-element loops that
+// publish_scan used to run, on SICK_MAX_NUM_MEASUREMENTS-sized scans.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <limits>
+#include <vector>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+#include <sickpls/SickPLS.hh>
+#include <sicktoolbox_pls_wrapper/range_conversion.h>
+using namespace SickToolbox;
+using namespace sicktoolbox_pls_wrapper;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The loops publish_scan had before the kernels, kept verbatim (including
+// the REP 117 test that looks at the output before writing it).
+static void legacy_rep_117(const uint32_t *range_values, std::vector<float> &ranges,
+                           size_t n_range_values, double scale)
+{
+  for (size_t i = 0; i < n_range_values; i++) {
+    if (ranges[i] > 5000)
+      ranges[i] = std::numeric_limits<float>::infinity();
+    else
+      ranges[i] = (float)range_values[i] * (float)scale;
+  }
+}
+
+static void legacy(const uint32_t *range_values, std::vector<float> &ranges,
+                   size_t n_range_values, double scale)
+{
+  for (size_t i = 0; i < n_range_values; i++)
+    ranges[i] = (float)range_values[i] * (float)scale;
+}
+
+// Keeps the compiler from throwing the result away.
+static volatile float sink;
+
+static void report(const char *name, double seconds, int iterations)
+{
+  printf("%-28s %8.1f ns/scan\n", name, seconds / iterations * 1e9);
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = 200000;
+  if (argc > 1)
+    iterations = atoi(argv[1]);
+  if (iterations <= 0)
+  {
+    printf("Usage: bench_range_conversion [ITERATIONS]\n");
+    return 1;
+  }
+
+  const size_t n = SickPLS::SICK_MAX_NUM_MEASUREMENTS;
+  std::vector<uint32_t> raw(n);
+  srand(1);
+  for (size_t i = 0; i < n; i++)
+    raw[i] = (rand() % 10 == 0) ? 5105 : rand() % 5000; // ~10% out of range
+  std::vector<float> ranges(n);
+  std::vector<float> specialized(n);
+  const double scale = 0.01;
+  int mismatches = 0;
+
+  printf("%u readings per scan, %d scans, default kernel: %s\n\n", (unsigned)n, iterations,
+         range_kernel_name(selected_range_kernel()));
+
+  double t = now();
+  for (int k = 0; k < iterations; k++) {
+    legacy(&raw[0], ranges, n, scale);
+    sink = ranges[k % n];
+  }
+  report("legacy", now() - t, iterations);
+
+  t = now();
+  for (int k = 0; k < iterations; k++) {
+    legacy_rep_117(&raw[0], ranges, n, scale);
+    sink = ranges[k % n];
+  }
+  report("legacy rep_117", now() - t, iterations);
+
+  for (int isa = 0; isa < RANGE_KERNEL_COUNT; isa++) {
+    if (!range_kernel_available((RangeKernelIsa)isa))
+      continue;
+    for (int mode = 0; mode < 4; mode++) {
+      bool reverse = mode & 1;
+      bool mask = mode & 2;
+      char name[64];
+      snprintf(name, sizeof(name), "%s%s%s", range_kernel_name((RangeKernelIsa)isa),
+               mask ? " rep_117" : "", reverse ? " inverted" : "");
+      t = now();
+      for (int k = 0; k < iterations; k++) {
+        convert_ranges((RangeKernelIsa)isa, &raw[0], &ranges[0], n, (float)scale, reverse, mask);
+        sink = ranges[k % n];
+      }
+      report(name, now() - t, iterations);
+
+      // What the publishers call: picked once, units compiled in
+      RangeConverter converter = select_range_converter((RangeKernelIsa)isa, range_units(scale),
+                                                        reverse, mask);
+      snprintf(name, sizeof(name), "%s%s%s cm", range_kernel_name((RangeKernelIsa)isa),
+               mask ? " rep_117" : "", reverse ? " inverted" : "");
+      t = now();
+      for (int k = 0; k < iterations; k++) {
+        converter(&raw[0], &specialized[0], n, (float)scale);
+        sink = specialized[k % n];
+      }
+      report(name, now() - t, iterations);
+      for (size_t i = 0; i < n; i++) {
+        if (specialized[i] != ranges[i]) {
+          printf("  %s differs at reading %u: %g, not %g\n", name, (unsigned)i, specialized[i], ranges[i]);
+          mismatches++;
+          break;
+        }
+      }
+    }
+  }
+  return mismatches ? 1 : 0;
+}
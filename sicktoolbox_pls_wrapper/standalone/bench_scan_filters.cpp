@@ -0,0 +1,169 @@
+///////////////////////////////////////////////////////////////////////////////
+// times the in-driver scan filters on synthetic scans.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <deque>
+#include <vector>
+extern "C" {
+// not everyone has <cstdint>
+#include <stdint.h>
+}
+#include <sickpls/SickPLS.hh>
+#include <sicktoolbox_pls_wrapper/scan_filters.h>
+using namespace SickToolbox;
+using namespace sicktoolbox_pls_wrapper;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The temporal median the way consumers usually write it: a deque of
+// per-scan vectors and an nth_element per reading.
+static void naive_temporal_median(std::deque<std::vector<uint32_t> > &history, size_t window,
+                                  uint32_t *values, uint32_t n)
+{
+  history.push_back(std::vector<uint32_t>(values, values + n));
+  if (history.size() > window)
+    history.pop_front();
+  std::vector<uint32_t> column(history.size());
+  for (uint32_t i = 0; i < n; i++) {
+    for (size_t k = 0; k < history.size(); k++)
+      column[k] = history[k][i];
+    std::nth_element(column.begin(), column.begin() + column.size() / 2, column.end());
+    values[i] = column[column.size() / 2];
+  }
+}
+
+// Keeps the compiler from throwing the result away.
+static volatile uint32_t sink;
+
+static void report(const char *name, double seconds, int iterations)
+{
+  printf("%-28s %8.1f ns/scan\n", name, seconds / iterations * 1e9);
+}
+
+// A room: walls in the background, a couple of posts in front of them,
+// and a little noise.
+static void make_scan(std::vector<uint32_t> &scan, int k)
+{
+  for (size_t i = 0; i < scan.size(); i++) {
+    uint32_t wall = 2000 + (uint32_t)(500 * fabs(cos(i * M_PI / 360)));
+    bool post = (i > 100 && i < 110) || (i > 250 && i < 256);
+    scan[i] = (post ? 600 : wall) + (rand() % 7) - 3 + (k & 1);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = 20000;
+  if (argc > 1)
+    iterations = atoi(argv[1]);
+  if (iterations <= 0)
+  {
+    printf("Usage: bench_scan_filters [ITERATIONS]\n");
+    return 1;
+  }
+
+  const uint32_t n = SickPLS::SICK_MAX_NUM_MEASUREMENTS;
+  const int scans = 64;
+  std::vector<std::vector<uint32_t> > input(scans, std::vector<uint32_t>(n));
+  srand(1);
+  for (int k = 0; k < scans; k++)
+    make_scan(input[k], k);
+  std::vector<uint32_t> values(n);
+
+  printf("%u readings per scan, %d scans\n\n", (unsigned)n, iterations);
+
+  const uint32_t windows[] = { 3, 5, 9 };
+  for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+    char name[64];
+    std::deque<std::vector<uint32_t> > history;
+    double t = now();
+    for (int k = 0; k < iterations; k++) {
+      values = input[k % scans];
+      naive_temporal_median(history, windows[w], &values[0], n);
+      sink = values[k % n];
+    }
+    snprintf(name, sizeof(name), "naive temporal median %u", windows[w]);
+    report(name, now() - t, iterations);
+
+    TemporalMedianFilter temporal(windows[w], n);
+    t = now();
+    for (int k = 0; k < iterations; k++) {
+      values = input[k % scans];
+      temporal.apply(&values[0], n);
+      sink = values[k % n];
+    }
+    snprintf(name, sizeof(name), "temporal median %u", windows[w]);
+    report(name, now() - t, iterations);
+
+    SpatialMedianFilter spatial(windows[w], n);
+    t = now();
+    for (int k = 0; k < iterations; k++) {
+      values = input[k % scans];
+      spatial.apply(&values[0], n);
+      sink = values[k % n];
+    }
+    snprintf(name, sizeof(name), "spatial median %u", windows[w]);
+    report(name, now() - t, iterations);
+  }
+
+  for (uint32_t window = 1; window <= 3; window++) {
+    char name[64];
+    ShadowFilter shadow(10 * M_PI / 180, 170 * M_PI / 180, window, M_PI / (n - 1), n);
+    double t = now();
+    for (int k = 0; k < iterations; k++) {
+      values = input[k % scans];
+      shadow.apply(&values[0], n);
+      sink = values[k % n];
+    }
+    snprintf(name, sizeof(name), "shadow %u", window);
+    report(name, now() - t, iterations);
+  }
+
+  // What the driver runs with every filter on.
+  ScanFilterChain chain;
+  chain.add(boost::shared_ptr<ScanFilter>(new TemporalMedianFilter(5, n)));
+  chain.add(boost::shared_ptr<ScanFilter>(new SpatialMedianFilter(3, n)));
+  chain.add(boost::shared_ptr<ScanFilter>(new ShadowFilter(10 * M_PI / 180, 170 * M_PI / 180, 1, M_PI / (n - 1), n)));
+  double t = now();
+  for (int k = 0; k < iterations; k++) {
+    values = input[k % scans];
+    chain.apply(&values[0], n);
+    sink = values[k % n];
+  }
+  report("chain (5, 3, 1)", now() - t, iterations);
+  return 0;
+}
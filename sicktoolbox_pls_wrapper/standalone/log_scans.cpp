@@ -1,5 +1,6 @@
 ///////////////////////////////////////////////////////////////////////////////
-// a little program that dumps PLS scans to disk in ASCII.
+// a little program that dumps PLS scans to disk, in the binary log format
+// by default or in ASCII with --ascii.
 //
 // Copyright (C) 2010, Morgan Quigley
 //
@@ -34,10 +35,15 @@ extern "C" {
 #include <stdint.h>
 }
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
 #include <sickpls/SickPLS.hh>
 #include <ros/time.h>
+#include <sicktoolbox_pls_wrapper/pls_log_async.h>
 using namespace SickToolbox;
 using namespace std;
+using namespace sicktoolbox_pls_wrapper;
 
 bool got_ctrlc = false;
 void ctrlc_handler(int)
@@ -45,17 +51,55 @@ void ctrlc_handler(int)
   got_ctrlc = true;
 }
 
+void usage()
+{
+  printf("Usage: log_scans [options] DEVICE BAUD_RATE FILENAME\n"
+         "  -a, --ascii   write \"%%.6f %%d %%d ...\" lines instead of a binary log\n"
+         "  -z            compress the binary log in LZ4 blocks\n"
+         "  -b SCANS      scans per write, and per compressed block (default 64)\n"
+         "  -Q SCANS      scans to queue for the disk before dropping new ones (default 256)\n"
+         "  -r MB         start a new file once one reaches this size\n"
+         "  -t SECONDS    start a new file once one has been open this long\n"
+         "  -s SECONDS    fdatasync at least this often (default only when a file is closed)\n"
+         "  -q            don't print ranges to the console\n"
+         "Rotated files are named after FILENAME and the UTC time they were started.\n");
+}
+
 int main(int argc, char **argv)
 {
-  if (argc != 4)
+  AsyncLogOptions options;
+  bool quiet = false;
+  static const struct option long_options[] = {
+    { "ascii", no_argument, NULL, 'a' },
+    { NULL, 0, NULL, 0 }
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "azb:Q:r:t:s:qh", long_options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+      case 'a': options.ascii = true; break;
+      case 'z': options.compress = true; break;
+      case 'b': options.batch_size = strtoul(optarg, NULL, 10); break;
+      case 'Q': options.queue_size = strtoul(optarg, NULL, 10); break;
+      case 'r': options.rotate_bytes = (uint64_t)(atof(optarg) * 1024 * 1024); break;
+      case 't': options.rotate_seconds = atof(optarg); break;
+      case 's': options.sync_seconds = atof(optarg); break;
+      case 'q': quiet = true; break;
+      default: usage(); return 1;
+    }
+  }
+  if (argc - optind != 3)
   {
-    printf("Usage: log_scans DEVICE BAUD_RATE FILENAME\n");
+    usage();
     return 1;
   }
-  FILE *log = fopen(argv[3],"w");
-  if (!log)
+  argv += optind - 1;
+  AsyncLogWriter log;
+  // the units get filled in once the laser tells us
+  if (!log.open(argv[3], argv[1], atoi(argv[2]), SickPLS::SICK_MEASURING_UNITS_UNKNOWN, options))
   {
-    fprintf(stderr, "couldn't open logfile %s\n", argv[3]);
+    fprintf(stderr, "couldn't open logfile %s: %s\n", argv[3], log.error().c_str());
     return 1;
   }
   string pls_dev = argv[1];
@@ -66,12 +110,12 @@ int main(int argc, char **argv)
     return 1;
   }
   signal(SIGINT, ctrlc_handler);
-  uint32_t values[SickPLS::SICK_MAX_NUM_MEASUREMENTS] = {0};
-  uint32_t num_values = 0;
+  PlsScan scan;
   SickPLS sick_pls(pls_dev);
   try
   {
     sick_pls.Initialize(desired_baud);
+    log.setUnits(sick_pls.GetSickMeasuringUnits());
   }
   catch (...)
   {
@@ -81,21 +125,27 @@ int main(int argc, char **argv)
   {
     while (!got_ctrlc)
     {
-      sick_pls.GetSickScan(values, num_values);
+      sick_pls.GetSickScan(scan.ranges, scan.size);
+      scan.host_stamp_ns = ros::Time::now().toNSec();
+      scan.deriveStatus();
+      // Queued, never waited on; a slow disk drops logged scans, not frames
+      log.append(scan);
+      if (log.failed())
+      {
+        fprintf(stderr, "%s\n", log.error().c_str());
+        break;
+      }
+      if (quiet)
+        continue;
       // print 12 ranges to the console
-      int inc = num_values / 11;
+      int inc = scan.size / 11;
       printf("%5d %5d %5d %5d %5d %5d %5d %5d %5d %5d %5d %5d\n", 
-             values[0],     values[inc], 
-             values[2*inc], values[3*inc],
-             values[4*inc], values[5*inc],
-             values[6*inc], values[7*inc],
-             values[8*inc], values[9*inc],
-             values[10*inc], values[num_values-1]);
-      // dump all these guys to disk
-      fprintf(log, "%.6f ", ros::Time::now().toSec());
-      for (unsigned i = 0; i < num_values; i++)
-        fprintf(log, "%d ", values[i]);
-      fprintf(log, "\n");
+             scan.ranges[0],     scan.ranges[inc], 
+             scan.ranges[2*inc], scan.ranges[3*inc],
+             scan.ranges[4*inc], scan.ranges[5*inc],
+             scan.ranges[6*inc], scan.ranges[7*inc],
+             scan.ranges[8*inc], scan.ranges[9*inc],
+             scan.ranges[10*inc], scan.ranges[scan.size-1]);
     }
   }
   catch (...)
@@ -111,7 +161,13 @@ int main(int argc, char **argv)
     printf("error during uninitialize\n");
     return 1;
   }
-  fclose(log);
+  bool closed = log.close();
+  printf("%lu scans logged to %lu files, %lu dropped\n", log.written(), log.files(), log.dropped());
+  if (!closed)
+  {
+    fprintf(stderr, "%s\n", log.error().c_str());
+    return 1;
+  }
   printf("success.\n");
   return 0;
 }
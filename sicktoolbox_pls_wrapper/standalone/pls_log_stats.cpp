@@ -0,0 +1,389 @@
+///////////////////////////////////////////////////////////////////////////////
+// per-bin statistics over binary PLS logs, for finding dirty windows and
+// failing bins after a run.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <stdint.h>
+#include <boost/thread.hpp>
+#include <sickpls/SickPLS.hh>
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <sicktoolbox_pls_wrapper/pls_log.h>
+using namespace SickToolbox;
+using namespace std;
+using namespace sicktoolbox_pls_wrapper;
+
+// What one bin (reading index) saw over a stretch of consecutive scans.
+// Sums are kept in integers, so merging stretches is exact and doesn't
+// depend on how the log was split up.
+struct BinStats
+{
+  uint64_t scans;
+  uint64_t valid;
+  uint64_t invalid;
+  uint64_t sum;
+  uint64_t sum_sq;
+  // Runs of the same valid reading in consecutive scans: the one the
+  // stretch starts with, the one it ends with and the longest.
+  uint64_t first_run;
+  uint64_t last_run;
+  uint64_t longest_run;
+  uint32_t first_value;
+  uint32_t last_value;
+
+  BinStats() { memset(this, 0, sizeof(*this)); }
+
+  // This stretch followed directly by next.
+  void append(const BinStats &next)
+  {
+    if (next.scans == 0)
+      return;
+    if (scans == 0) {
+      *this = next;
+      return;
+    }
+    bool joined = last_run && next.first_run && last_value == next.first_value;
+    longest_run = std::max(std::max(longest_run, next.longest_run),
+                           joined ? last_run + next.first_run : 0);
+    if (joined && first_run == scans)
+      first_run += next.first_run;
+    if (joined && next.last_run == next.scans)
+      last_run += next.last_run;
+    else
+      last_run = next.last_run;
+    last_value = next.last_value;
+    scans += next.scans;
+    valid += next.valid;
+    invalid += next.invalid;
+    sum += next.sum;
+    sum_sq += next.sum_sq;
+  }
+
+  double mean() const { return valid ? (double)sum / valid : 0; }
+  double stddev() const
+  {
+    if (valid < 2)
+      return 0;
+    double m = mean();
+    double variance = (double)sum_sq / valid - m * m;
+    return variance > 0 ? sqrt(variance) : 0;
+  }
+  double invalidRate() const { return scans ? (double)invalid / scans : 0; }
+};
+
+// One thread's share of a log. The bins are kept as columns and updated
+// without branches, one scan at a time; they're small enough to stay in
+// cache however long the log is. Each worker allocates its own, on its own
+// thread, so no two workers write to the same cache lines.
+class Worker
+{
+public:
+  Worker(const PlsLogReader &log, uint64_t begin, uint64_t end, uint32_t num_bins,
+         uint32_t max_valid)
+    : log_(log), begin_(begin), end_(end), num_bins_(num_bins), max_valid_(max_valid)
+  {
+  }
+
+  void operator()()
+  {
+    uint32_t n = num_bins_;
+    vector<uint64_t> sum(n, 0), sum_sq(n, 0);
+    vector<uint32_t> scans(n, 0), valid(n, 0), run(n, 0), longest(n, 0), last(n, 0);
+    vector<uint32_t> first_run(n, 0), first_value(n, 0);
+    accumulate(&sum[0], &sum_sq[0], &scans[0], &valid[0], &run[0], &longest[0], &last[0],
+               &first_run[0], &first_value[0]);
+    bins_.resize(n);
+    for (uint32_t i = 0; i < n; i++) {
+      BinStats &b = bins_[i];
+      b.scans = scans[i];
+      b.valid = valid[i];
+      b.invalid = scans[i] - valid[i];
+      b.sum = sum[i];
+      b.sum_sq = sum_sq[i];
+      b.first_run = first_run[i];
+      b.first_value = first_value[i];
+      b.last_run = run[i];
+      b.last_value = last[i];
+      b.longest_run = longest[i];
+    }
+  }
+
+  // The columns don't alias, which the compiler has to be told before it
+  // will vectorize the inner loop (this file is built with -O3 for that).
+  void accumulate(uint64_t *__restrict sum, uint64_t *__restrict sum_sq, uint32_t *__restrict scans,
+                  uint32_t *__restrict valid, uint32_t *__restrict run, uint32_t *__restrict longest,
+                  uint32_t *__restrict last, uint32_t *__restrict first_run,
+                  uint32_t *__restrict first_value)
+  {
+    const uint32_t n = num_bins_;
+    const uint32_t max_valid = max_valid_;
+    for (uint64_t k = begin_; k < end_; k++) {
+      const PlsLogRecord &record = log_[k];
+      const uint16_t *ranges = record.ranges();
+      uint32_t m = std::min<uint32_t>(record.num_ranges, n);
+      for (uint32_t i = 0; i < m; i++) {
+        uint32_t v = ranges[i];
+        uint32_t ok = v <= max_valid;
+        uint32_t mask = -ok;
+        valid[i] += ok;
+        sum[i] += v & mask;
+        sum_sq[i] += (uint64_t)(v * v) & (uint64_t)(int64_t)(int32_t)mask;
+        // A valid reading carries the run on if it's the same as the last
+        // one, starts a new one if not; an invalid one ends it.
+        uint32_t same = -(uint32_t)(run[i] != 0 && v == last[i]);
+        run[i] = (run[i] & same) + ok;
+        last[i] ^= (last[i] ^ v) & mask;
+        longest[i] = std::max(longest[i], run[i]);
+        // Still in the first run while the run is as long as the stretch
+        uint32_t open = -(uint32_t)(run[i] == scans[i] + 1);
+        first_run[i] ^= (first_run[i] ^ run[i]) & open;
+        first_value[i] ^= (first_value[i] ^ v) & open;
+        scans[i]++;
+      }
+    }
+  }
+
+  const vector<BinStats> &bins() const { return bins_; }
+
+private:
+  const PlsLogReader &log_;
+  uint64_t begin_;
+  uint64_t end_;
+  uint32_t num_bins_;
+  uint32_t max_valid_;
+  vector<BinStats> bins_;
+};
+
+struct Options
+{
+  unsigned threads;
+  uint32_t max_valid;
+  double stuck_seconds;
+  double noise_factor;
+  double invalid_rate;
+};
+
+struct Totals
+{
+  uint64_t scans;
+  uint64_t bytes;
+  uint64_t first_stamp_ns;
+  uint64_t last_stamp_ns;
+  uint32_t num_bins;
+  uint32_t units;
+  vector<BinStats> bins;
+
+  Totals() : scans(0), bytes(0), first_stamp_ns(0), last_stamp_ns(0), num_bins(0), units(0) {}
+};
+
+// Adds a whole log to totals, split across the thread pool. Bins keep
+// counting on from the logs before it, in the order they were given.
+bool accumulate(const char *path, const Options &options, Totals &totals)
+{
+  PlsLogReader log;
+  if (!log.open(path)) {
+    fprintf(stderr, "%s\n", log.error().c_str());
+    return false;
+  }
+  uint64_t size = log.size();
+  if (size == 0)
+    return true;
+  if (totals.num_bins == 0) {
+    totals.num_bins = log.header().ranges_per_record;
+    totals.units = log.header().units;
+    totals.bins.resize(totals.num_bins);
+    totals.first_stamp_ns = log[0].stamp_ns;
+  }
+  else if (log.header().ranges_per_record != totals.num_bins) {
+    fprintf(stderr, "%s has %u readings per scan, not %u like the logs before it\n", path,
+            log.header().ranges_per_record, totals.num_bins);
+    return false;
+  }
+
+  unsigned threads = std::max<uint64_t>(1, std::min<uint64_t>(options.threads, size));
+  vector<Worker> workers;
+  workers.reserve(threads);
+  for (unsigned t = 0; t < threads; t++)
+    workers.push_back(Worker(log, size * t / threads, size * (t + 1) / threads, totals.num_bins,
+                             options.max_valid));
+  boost::thread_group pool;
+  for (unsigned t = 0; t < threads; t++)
+    pool.create_thread(boost::ref(workers[t]));
+  pool.join_all();
+
+  for (unsigned t = 0; t < threads; t++)
+    for (uint32_t i = 0; i < totals.num_bins; i++)
+      totals.bins[i].append(workers[t].bins()[i]);
+  totals.scans += size;
+  totals.bytes += size * log.header().record_size;
+  totals.last_stamp_ns = log[size - 1].stamp_ns;
+  return true;
+}
+
+double median(vector<double> values)
+{
+  if (values.empty())
+    return 0;
+  size_t mid = values.size() / 2;
+  nth_element(values.begin(), values.begin() + mid, values.end());
+  return values[mid];
+}
+
+// Angle of bin i in degrees, with the scan covering 180 degrees.
+double bin_angle(uint32_t i, uint32_t num_bins)
+{
+  return num_bins > 1 ? -90.0 + 180.0 * i / (num_bins - 1) : 0;
+}
+
+void usage()
+{
+  printf("Usage: pls_log_stats [options] LOGFILE...\n"
+         "  -j THREADS    worker threads (default one per CPU)\n"
+         "  -i VALUE      raw readings above this are invalid (default 5000)\n"
+         "  -t SECONDS    flag bins that repeat one reading this long (default 60)\n"
+         "  -k FACTOR     flag bins noisier than this times the median bin (default 3)\n"
+         "  -x FRACTION   flag bins invalid more often than this (default 0.5)\n"
+         "  -f FORMAT     text or csv; csv has a row per bin (default text)\n"
+         "  -o FILE       write the report to FILE instead of stdout\n"
+         "Logs are taken in the order given, as one run, e.g. the files of a rotated log.\n");
+}
+
+int main(int argc, char **argv)
+{
+  Options options;
+  options.threads = boost::thread::hardware_concurrency();
+  options.max_valid = 5000;
+  options.stuck_seconds = 60;
+  options.noise_factor = 3;
+  options.invalid_rate = 0.5;
+  string format = "text";
+  const char *output = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:i:t:k:x:f:o:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'j': options.threads = strtoul(optarg, NULL, 10); break;
+      case 'i': options.max_valid = strtoul(optarg, NULL, 10); break;
+      case 't': options.stuck_seconds = atof(optarg); break;
+      case 'k': options.noise_factor = atof(optarg); break;
+      case 'x': options.invalid_rate = atof(optarg); break;
+      case 'f': format = optarg; break;
+      case 'o': output = optarg; break;
+      default: usage(); return 1;
+    }
+  }
+  if (optind >= argc || (format != "text" && format != "csv"))
+  {
+    usage();
+    return 1;
+  }
+  if (options.threads == 0)
+    options.threads = 1;
+
+  uint64_t start_ns = monotonic_ns();
+  Totals totals;
+  for (int i = optind; i < argc; i++)
+    if (!accumulate(argv[i], options, totals))
+      return 1;
+  double elapsed = (monotonic_ns() - start_ns) * 1e-9;
+  if (totals.scans == 0)
+  {
+    fprintf(stderr, "no scans in the log\n");
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (output && !(out = fopen(output, "w")))
+  {
+    fprintf(stderr, "couldn't open %s\n", output);
+    return 1;
+  }
+
+  if (totals.units != SickPLS::SICK_MEASURING_UNITS_CM)
+    fprintf(stderr, "log doesn't record its measuring units, assuming cm\n");
+  const double scale = 0.01;
+  double duration = (totals.last_stamp_ns - totals.first_stamp_ns) * 1e-9;
+  double scan_rate = duration > 0 ? (totals.scans - 1) / duration : 75;
+  uint64_t stuck_scans = (uint64_t)(options.stuck_seconds * scan_rate + 0.5);
+
+  vector<double> stddevs;
+  uint64_t invalid = 0;
+  for (uint32_t i = 0; i < totals.num_bins; i++) {
+    stddevs.push_back(totals.bins[i].stddev());
+    invalid += totals.bins[i].invalid;
+  }
+  double median_stddev = median(stddevs);
+
+  if (format == "csv") {
+    fprintf(out, "bin,angle_deg,valid,invalid,invalid_rate,mean_m,stddev_m,longest_run_s,stuck,noisy,often_invalid\n");
+  }
+  else {
+    fprintf(out, "%lu scans of %u readings, %.1f h at %.2f Hz\n", (unsigned long)totals.scans,
+            totals.num_bins, duration / 3600, scan_rate);
+    fprintf(out, "read %.1f MB in %.2f s with %u threads (%.0f scans/s)\n", totals.bytes / 1e6, elapsed,
+            options.threads, totals.scans / std::max(elapsed, 1e-9));
+    fprintf(out, "invalid readings (> %u): %.3f%%\n", options.max_valid,
+            100.0 * invalid / ((double)totals.scans * totals.num_bins));
+    fprintf(out, "median bin standard deviation: %.4f m\n", median_stddev * scale);
+  }
+
+  unsigned flagged = 0;
+  for (uint32_t i = 0; i < totals.num_bins; i++) {
+    const BinStats &b = totals.bins[i];
+    bool stuck = stuck_scans > 0 && b.longest_run >= stuck_scans;
+    bool noisy = median_stddev > 0 && b.stddev() > options.noise_factor * median_stddev;
+    bool often_invalid = b.invalidRate() > options.invalid_rate;
+    if (format == "csv") {
+      fprintf(out, "%u,%.2f,%lu,%lu,%.6f,%.4f,%.4f,%.2f,%d,%d,%d\n", i, bin_angle(i, totals.num_bins),
+              (unsigned long)b.valid, (unsigned long)b.invalid, b.invalidRate(), b.mean() * scale,
+              b.stddev() * scale, b.longest_run / scan_rate, stuck, noisy, often_invalid);
+      continue;
+    }
+    if (!stuck && !noisy && !often_invalid)
+      continue;
+    if (flagged++ == 0)
+      fprintf(out, "flagged bins:\n");
+    fprintf(out, "  bin %3u (%6.1f deg): mean %.3f m, stddev %.4f m, %.1f%% invalid, longest repeat %.1f s:%s%s%s\n",
+            i, bin_angle(i, totals.num_bins), b.mean() * scale, b.stddev() * scale, 100 * b.invalidRate(),
+            b.longest_run / scan_rate, stuck ? " stuck" : "", noisy ? " noisy" : "",
+            often_invalid ? " often invalid" : "");
+  }
+  if (format == "text" && flagged == 0)
+    fprintf(out, "no bins flagged\n");
+
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+// Stands up simulated PLS sensors on ptys, for testing without hardware.
+//
+// Distributed under the BSD license:
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Stanford University nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//   
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <sicktoolbox_pls_wrapper/pls_simulator.h>
+using namespace std;
+using namespace sicktoolbox_pls_wrapper;
+
+bool got_ctrlc = false;
+void ctrlc_handler(int)
+{
+  got_ctrlc = true;
+}
+
+void usage()
+{
+  printf("Usage: pls_sim [options]\n"
+         "  -n SENSORS  how many to simulate (default 1)\n"
+         "  -l PREFIX   link PREFIX0, PREFIX1, ... to their ptys (default /tmp/sickpls)\n"
+         "  -b BAUD     baud rate at power-on: 9600, 19200, 38400 or 500000 (default 9600)\n"
+         "  -r HZ       scan rate (default 75)\n"
+         "  -u          send as fast as the host reads, not at the baud rate\n"
+         "  -v VALUES   readings per scan, 181 or 361 (default 361)\n"
+         "  -j MS       standard deviation of scan timing jitter\n"
+         "  -d RATE     fraction of scans that lose a byte\n"
+         "  -c RATE     fraction of scans with a corrupted byte\n"
+         "  -s SEED     random seed; sensor i uses SEED + i (default 1)\n"
+         "Runs until ^C. Drivers switch a sensor to continuous output themselves,\n"
+         "e.g. sick_pls_wrapper with ~streaming or time_scans -s.\n");
+}
+
+int main(int argc, char **argv)
+{
+  PlsSimulatorConfig config;
+  int sensors = 1;
+  string prefix = "/tmp/sickpls";
+  int opt;
+  while ((opt = getopt(argc, argv, "n:l:b:r:uv:j:d:c:s:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n': sensors = atoi(optarg); break;
+      case 'l': prefix = optarg; break;
+      case 'b': config.baud = atoi(optarg); break;
+      case 'r': config.scan_rate = atof(optarg); break;
+      case 'u': config.paced = false; break;
+      case 'v': config.num_values = atoi(optarg); break;
+      case 'j': config.jitter = atof(optarg) / 1000; break;
+      case 'd': config.drop_rate = atof(optarg); break;
+      case 'c': config.crc_error_rate = atof(optarg); break;
+      case 's': config.seed = strtoul(optarg, NULL, 0); break;
+      default: usage(); return 1;
+    }
+  }
+  if (optind != argc || sensors < 1)
+  {
+    usage();
+    return 1;
+  }
+
+  vector<PlsSimulator *> sims;
+  vector<string> links;
+  int status = 0;
+  for (int i = 0; i < sensors; i++)
+  {
+    PlsSimulatorConfig c = config;
+    c.seed = config.seed + i;
+    PlsSimulator *sim = new PlsSimulator(c);
+    sims.push_back(sim);
+    if (!sim->open())
+    {
+      fprintf(stderr, "sensor %d: %s\n", i, sim->error().c_str());
+      status = 1;
+      break;
+    }
+    char link[256];
+    snprintf(link, sizeof(link), "%s%d", prefix.c_str(), i);
+    unlink(link);
+    if (symlink(sim->devicePath().c_str(), link) < 0)
+    {
+      fprintf(stderr, "couldn't link %s: %s\n", link, strerror(errno));
+      status = 1;
+      break;
+    }
+    links.push_back(link);
+    printf("%s -> %s\n", link, sim->devicePath().c_str());
+  }
+  fflush(stdout);
+
+  signal(SIGINT, ctrlc_handler);
+  signal(SIGTERM, ctrlc_handler);
+  vector<struct pollfd> fds(sims.size());
+  while (status == 0 && !got_ctrlc)
+  {
+    uint64_t now = monotonic_ns();
+    uint64_t wake = now + 100000000;
+    for (size_t i = 0; i < sims.size(); i++) {
+      uint64_t next = sims[i]->service(now);
+      if (next < wake)
+        wake = next;
+      fds[i].fd = sims[i]->fd();
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+    }
+    now = monotonic_ns();
+    int timeout = wake > now ? (int)((wake - now + 999999) / 1000000) : 0;
+    if (poll(&fds[0], fds.size(), timeout) < 0 && errno != EINTR)
+    {
+      perror("poll");
+      status = 1;
+      break;
+    }
+    now = monotonic_ns();
+    for (size_t i = 0; i < sims.size(); i++) {
+      if ((fds[i].revents & POLLIN) && !sims[i]->handleInput(now)) {
+        fprintf(stderr, "%s: %s\n", links[i].c_str(), sims[i]->error().c_str());
+        status = 1;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < sims.size(); i++)
+  {
+    if (i < links.size())
+    {
+      printf("%s: %lu scans, %lu sent, %lu commands, %lu bytes dropped, %lu crc errors\n",
+             links[i].c_str(), sims[i]->scans(), sims[i]->scansSent(), sims[i]->commands(),
+             sims[i]->bytesDropped(), sims[i]->crcErrors());
+      unlink(links[i].c_str());
+    }
+    delete sims[i];
+  }
+  return status;
+}
@@ -37,8 +37,10 @@ extern "C" {
 }
 #include <cstdio>
 #include <sickpls/SickPLS.hh>
+#include <sicktoolbox_pls_wrapper/pls_scan.h>
 using namespace SickToolbox;
 using namespace std;
+using namespace sicktoolbox_pls_wrapper;
 
 bool got_ctrlc = false;
 void ctrlc_handler(int)
@@ -61,8 +63,7 @@ int main(int argc, char **argv)
     return 1;
   }
   signal(SIGINT, ctrlc_handler);
-  uint32_t values[SickPLS::SICK_MAX_NUM_MEASUREMENTS] = {0};
-  uint32_t num_values = 0;
+  PlsScan scan;
   SickPLS sick_pls(pls_dev);
   try
   {
@@ -76,16 +77,16 @@ int main(int argc, char **argv)
   {
     while (!got_ctrlc)
     {
-      sick_pls.GetSickScan(values, num_values);
+      sick_pls.GetSickScan(scan.ranges, scan.size);
       // print 12 ranges to the console
-      int inc = num_values / 11;
+      int inc = scan.size / 11;
       printf("%5d %5d %5d %5d %5d %5d %5d %5d %5d %5d %5d %5d\n", 
-             values[0],     values[inc], 
-             values[2*inc], values[3*inc],
-             values[4*inc], values[5*inc],
-             values[6*inc], values[7*inc],
-             values[8*inc], values[9*inc],
-             values[10*inc], values[num_values-1]);
+             scan.ranges[0],     scan.ranges[inc], 
+             scan.ranges[2*inc], scan.ranges[3*inc],
+             scan.ranges[4*inc], scan.ranges[5*inc],
+             scan.ranges[6*inc], scan.ranges[7*inc],
+             scan.ranges[8*inc], scan.ranges[9*inc],
+             scan.ranges[10*inc], scan.ranges[scan.size-1]);
     }
   }
   catch (...)
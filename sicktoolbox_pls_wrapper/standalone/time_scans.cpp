@@ -32,12 +32,26 @@
 
 #include <cstdlib>
 #include <csignal>
-#include <stdint.h>
 #include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <stdint.h>
 #include <sickpls/SickPLS.hh>
-#include "ros/time.h"
+#include <sicktoolbox_pls_wrapper/latency_histogram.h>
+#include <sicktoolbox_pls_wrapper/pls_scan.h>
+#include <sicktoolbox_pls_wrapper/pls_stream.h>
+#include <sicktoolbox_pls_wrapper/scan_timestamper.h>
 using namespace SickToolbox;
 using namespace std;
+using namespace sicktoolbox_pls_wrapper;
+
+// The mirror turns at 75 Hz; slower links only carry every second or
+// third scan (see ScanTimestamper::framePeriod).
+const double NOMINAL_SCAN_TIME = 1.0 / 75;
 
 bool got_ctrlc = false;
 void ctrlc_handler(int)
@@ -45,69 +59,312 @@ void ctrlc_handler(int)
   got_ctrlc = true;
 }
 
-int main(int argc, char **argv)
+struct RunResult
 {
-  if (argc != 3)
+  int baud;
+  bool ok;
+  string error;
+  uint32_t num_ranges;
+  size_t samples;
+  double elapsed;          // seconds over the timed samples
+  double expected_period;  // one telegram per this many seconds at this baud
+  double min, mean, p50, p99, p999, max;
+  double achieved_hz;
+  unsigned long missed;    // frames that never showed up
+  unsigned long late;      // frames that showed up late, but before the next one
+  unsigned long crc_errors; // streaming only
+
+  explicit RunResult(int baud)
+    : baud(baud), ok(false), num_ranges(0), samples(0), elapsed(0), expected_period(0),
+      min(0), mean(0), p50(0), p99(0), p999(0), max(0), achieved_hz(0), missed(0), late(0),
+      crc_errors(0)
   {
-    printf("Usage: print_scans DEVICE BAUD_RATE\n");
-    return 1;
   }
-  string pls_dev = argv[1];
-  SickPLS::sick_pls_baud_t desired_baud = SickPLS::StringToSickBaud(argv[2]);
-  if (desired_baud == SickPLS::SICK_BAUD_UNKNOWN)
+};
+
+// Reads scans through sicktoolbox or, with -s, from a PlsStream.
+class ScanSource
+{
+public:
+  ScanSource(const string &device, bool streaming)
+    : device_(device), streaming_(streaming), sick_pls_(device)
   {
-    printf("bad baud rate. must be one of {9600, 19200, 38400, 500000}\n");
-    return 1;
   }
 
-  signal(SIGINT, ctrlc_handler);
+  void initialize(int baud)
+  {
+    if (!streaming_)
+      sick_pls_.Initialize(SickPLS::IntToSickBaud(baud));
+    else if (!stream_.open(device_, baud))
+      throw SickIOException(stream_.error());
+  }
 
-  uint32_t values[SickPLS::SICK_MAX_NUM_MEASUREMENTS] = {0};
-  uint32_t num_values = 0;
-  SickPLS sick_pls(pls_dev);
+  void read(PlsScan &scan)
+  {
+    scan.read_begin_ns = monotonic_ns();
+    if (!streaming_) {
+      sick_pls_.GetSickScan(scan.ranges, scan.size);
+    }
+    else {
+      int got = stream_.next(scan.ranges, scan.size, 1.0);
+      if (got == 0)
+        throw SickTimeoutException("no scan for 1 s");
+      if (got < 0)
+        throw SickIOException(stream_.error());
+    }
+    scan.read_end_ns = monotonic_ns();
+  }
+
+  void uninitialize()
+  {
+    if (streaming_)
+      stream_.close();
+    else
+      sick_pls_.Uninitialize();
+  }
+
+  unsigned long crcErrors() const { return stream_.crcErrors(); }
+
+private:
+  string device_;
+  bool streaming_;
+  SickPLS sick_pls_;
+  PlsStream stream_;
+};
+
+// Nearest-rank percentile of sorted values.
+double percentile(const vector<double> &sorted, double p)
+{
+  if (sorted.empty())
+    return 0;
+  size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+  if (rank < 1)
+    rank = 1;
+  return sorted[min(rank, sorted.size()) - 1];
+}
+
+RunResult time_baud(const string &device, bool streaming, int baud, size_t warmup,
+                    size_t samples, double late_fraction, bool verbose)
+{
+  RunResult r(baud);
+
+  PlsScan scan;
+  ScanSource source(device, streaming);
 
   try
   {
-    sick_pls.Initialize(desired_baud);
+    source.initialize(baud);
   }
   catch (...)
   {
-    printf("initialize failed! are you using the correct device path?\n");
+    r.error = "initialize failed";
+    return r;
   }
 
+  vector<double> deltas;
+  deltas.reserve(samples ? samples : 4096);
   try
   {
-    ros::Time prev_scan_time = ros::Time::now();
-    while (!got_ctrlc) {
-      sick_pls.GetSickScan(values, num_values);
-      ros::Time t = ros::Time::now();
-      double delta = t.toSec() - prev_scan_time.toSec();
-      printf("%f (%f)\n", delta, 1.0 / delta);
-      prev_scan_time = t;
+    for (size_t i = 0; i < warmup && !got_ctrlc; i++)
+      source.read(scan);
+    uint64_t first = 0, prev = 0;
+    while (!got_ctrlc && (samples == 0 || deltas.size() < samples)) {
+      source.read(scan);
+      uint64_t t = scan.read_end_ns;
+      if (prev == 0) {
+        first = t;
+        r.num_ranges = scan.size;
+        r.expected_period = ScanTimestamper::framePeriod(NOMINAL_SCAN_TIME, baud, scan.size);
+      }
+      else {
+        double delta = (t - prev) * 1e-9;
+        deltas.push_back(delta);
+        if (verbose)
+          printf("%f (%f)\n", delta, 1.0 / delta);
+        unsigned long frames = (unsigned long)(delta / r.expected_period + 0.5);
+        if (frames >= 2)
+          r.missed += frames - 1;
+        else if (delta > r.expected_period * (1 + late_fraction))
+          r.late++;
+      }
+      prev = t;
     }
+    r.elapsed = (prev - first) * 1e-9;
+    r.ok = true;
   }
   catch (SickException &e)
   {
-    std::cout<<"Exception: "<<e.what()<<std::endl;
+    r.error = e.what();
   }
   catch (...)
   {
-    printf("woah! error!\n");
+    r.error = "error while reading scans";
   }
 
-
   try
   {
-    sick_pls.Uninitialize();
+    source.uninitialize();
   }
   catch (...)
   {
-    printf("error during uninitialize\n");
-    return 1;
+    if (r.ok) {
+      r.ok = false;
+      r.error = "error during uninitialize";
+    }
+  }
+
+  r.crc_errors = source.crcErrors();
+  r.samples = deltas.size();
+  if (!deltas.empty()) {
+    double sum = 0;
+    for (size_t i = 0; i < deltas.size(); i++)
+      sum += deltas[i];
+    sort(deltas.begin(), deltas.end());
+    r.min = deltas.front();
+    r.max = deltas.back();
+    r.mean = sum / deltas.size();
+    r.p50 = percentile(deltas, 50);
+    r.p99 = percentile(deltas, 99);
+    r.p999 = percentile(deltas, 99.9);
+    r.achieved_hz = r.elapsed > 0 ? deltas.size() / r.elapsed : 0;
+  }
+  return r;
+}
+
+void print_text(FILE *out, const RunResult &r)
+{
+  fprintf(out, "baud %d: ", r.baud);
+  if (!r.ok)
+    fprintf(out, "FAILED (%s)\n", r.error.c_str());
+  else
+    fprintf(out, "%lu samples of %u ranges over %.3f s\n", (unsigned long)r.samples, r.num_ranges, r.elapsed);
+  if (r.samples == 0)
+    return;
+  fprintf(out, "  inter-arrival (ms): min %.3f mean %.3f p50 %.3f p99 %.3f p99.9 %.3f max %.3f\n",
+          r.min * 1e3, r.mean * 1e3, r.p50 * 1e3, r.p99 * 1e3, r.p999 * 1e3, r.max * 1e3);
+  fprintf(out, "  frequency: %.3f Hz achieved, %.3f Hz expected at this baud, %.0f Hz nominal\n",
+          r.achieved_hz, 1.0 / r.expected_period, 1.0 / NOMINAL_SCAN_TIME);
+  fprintf(out, "  frames: %lu missed, %lu late, %lu checksum errors\n", r.missed, r.late, r.crc_errors);
+}
+
+void print_json(FILE *out, const string &device, const vector<RunResult> &results)
+{
+  fprintf(out, "{\n  \"device\": \"%s\",\n  \"nominal_hz\": %.3f,\n  \"runs\": [", device.c_str(), 1.0 / NOMINAL_SCAN_TIME);
+  for (size_t i = 0; i < results.size(); i++) {
+    const RunResult &r = results[i];
+    fprintf(out, "%s\n    {\"baud\": %d, \"ok\": %s", i ? "," : "", r.baud, r.ok ? "true" : "false");
+    if (!r.ok)
+      fprintf(out, ", \"error\": \"%s\"", r.error.c_str());
+    fprintf(out, ", \"num_ranges\": %u, \"samples\": %lu, \"elapsed_s\": %.6f, \"expected_hz\": %.3f, \"achieved_hz\": %.3f,"
+            " \"min_s\": %.6f, \"mean_s\": %.6f, \"p50_s\": %.6f, \"p99_s\": %.6f, \"p99_9_s\": %.6f, \"max_s\": %.6f,"
+            " \"missed\": %lu, \"late\": %lu, \"crc_errors\": %lu}",
+            r.num_ranges, (unsigned long)r.samples, r.elapsed, r.expected_period > 0 ? 1.0 / r.expected_period : 0,
+            r.achieved_hz, r.min, r.mean, r.p50, r.p99, r.p999, r.max, r.missed, r.late, r.crc_errors);
   }
-  printf("success.\n");
+  fprintf(out, "\n  ]\n}\n");
+}
 
+void print_csv(FILE *out, const string &device, const vector<RunResult> &results)
+{
+  fprintf(out, "device,baud,ok,num_ranges,samples,elapsed_s,expected_hz,achieved_hz,"
+          "min_s,mean_s,p50_s,p99_s,p99_9_s,max_s,missed,late,crc_errors\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const RunResult &r = results[i];
+    fprintf(out, "%s,%d,%d,%u,%lu,%.6f,%.3f,%.3f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%lu,%lu,%lu\n",
+            device.c_str(), r.baud, r.ok ? 1 : 0, r.num_ranges, (unsigned long)r.samples, r.elapsed,
+            r.expected_period > 0 ? 1.0 / r.expected_period : 0, r.achieved_hz,
+            r.min, r.mean, r.p50, r.p99, r.p999, r.max, r.missed, r.late, r.crc_errors);
+  }
+}
 
-  return 0;
+void usage()
+{
+  printf("Usage: time_scans [options] DEVICE BAUD_RATE\n"
+         "       time_scans [options] -a DEVICE\n"
+         "  -a            time every baud rate in turn (9600, 19200, 38400, 500000)\n"
+         "  -w SCANS      scans to discard before timing (default 75)\n"
+         "  -n SCANS      inter-arrival times to record per baud, 0 for until ^C (default 750)\n"
+         "  -l FRACTION   count a frame late past this fraction of its period (default 0.25)\n"
+         "  -f FORMAT     text, json or csv (default text)\n"
+         "  -o FILE       write the report to FILE instead of stdout\n"
+         "  -s            stream scans in continuous output mode instead of via sicktoolbox\n"
+         "  -v            print every inter-arrival time as it comes in\n");
 }
 
+int main(int argc, char **argv)
+{
+  bool all_bauds = false;
+  bool verbose = false;
+  bool streaming = false;
+  size_t warmup = 75;
+  size_t samples = 750;
+  double late_fraction = 0.25;
+  string format = "text";
+  const char *output = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "aw:n:l:f:o:svh")) != -1)
+  {
+    switch (opt)
+    {
+      case 'a': all_bauds = true; break;
+      case 'w': warmup = strtoul(optarg, NULL, 10); break;
+      case 'n': samples = strtoul(optarg, NULL, 10); break;
+      case 'l': late_fraction = atof(optarg); break;
+      case 'f': format = optarg; break;
+      case 'o': output = optarg; break;
+      case 's': streaming = true; break;
+      case 'v': verbose = true; break;
+      default: usage(); return 1;
+    }
+  }
+  if (argc - optind != (all_bauds ? 1 : 2) || (format != "text" && format != "json" && format != "csv"))
+  {
+    usage();
+    return 1;
+  }
+  string pls_dev = argv[optind];
+
+  vector<int> bauds;
+  if (all_bauds) {
+    bauds.push_back(9600);
+    bauds.push_back(19200);
+    bauds.push_back(38400);
+    bauds.push_back(500000);
+  }
+  else {
+    if (SickPLS::StringToSickBaud(argv[optind + 1]) == SickPLS::SICK_BAUD_UNKNOWN)
+    {
+      printf("bad baud rate. must be one of {9600, 19200, 38400, 500000}\n");
+      return 1;
+    }
+    bauds.push_back(atoi(argv[optind + 1]));
+  }
+
+  FILE *out = stdout;
+  if (output && !(out = fopen(output, "w")))
+  {
+    fprintf(stderr, "couldn't open %s\n", output);
+    return 1;
+  }
+
+  signal(SIGINT, ctrlc_handler);
+
+  vector<RunResult> results;
+  bool ok = true;
+  for (size_t i = 0; i < bauds.size() && !got_ctrlc; i++) {
+    if (format != "text" || output)
+      fprintf(stderr, "timing %s at %d baud...\n", pls_dev.c_str(), bauds[i]);
+    results.push_back(time_baud(pls_dev, streaming, bauds[i], warmup, samples, late_fraction, verbose));
+    ok = ok && results.back().ok;
+    if (format == "text")
+      print_text(out, results.back());
+  }
+  if (format == "json")
+    print_json(out, pls_dev, results);
+  else if (format == "csv")
+    print_csv(out, pls_dev, results);
+
+  if (out != stdout)
+    fclose(out);
+  return ok ? 0 : 1;
+}